@@ -0,0 +1,107 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "alloc.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace CKnot
+{
+
+    namespace
+    {
+        thread_local AllocCounters Counters;
+    }
+
+
+    AllocCounters& GetAllocCounters()
+    {
+        return Counters;
+    }
+
+}
+
+
+#ifdef CKNOT_ALLOC_STATS
+
+namespace
+{
+    //Each block starts with its size, padded to keep the rest aligned for anything.
+    const size_t Header = 16;
+
+    void* Allocate(size_t size)
+    {
+        char* p = static_cast<char*>(std::malloc(size + Header));
+        if (!p)
+            throw std::bad_alloc();
+
+        *reinterpret_cast<size_t*>(p) = size;
+
+        CKnot::AllocCounters& c = CKnot::GetAllocCounters();
+        ++c.count;
+        c.bytes += size;
+        c.live += size;
+        if (c.live > c.peak)
+            c.peak = c.live;
+
+        return p + Header;
+    }
+
+    void Free(void* ptr)
+    {
+        if (!ptr)
+            return;
+
+        char* p = static_cast<char*>(ptr) - Header;
+        CKnot::GetAllocCounters().live -= *reinterpret_cast<size_t*>(p);
+        std::free(p);
+    }
+}
+
+
+void* operator new(size_t size)
+{
+    return Allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+    return Allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    Free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    Free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    Free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    Free(p);
+}
+
+#endif
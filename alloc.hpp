@@ -0,0 +1,43 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ALLOC_HPP__
+#define __ALLOC_HPP__
+
+#include <cstddef>
+
+///Heap accounting.
+/**Build with CKNOT_ALLOC_STATS defined to replace the global operator new and delete with
+ * versions that count, per thread, every allocation and the bytes still live. Stats phases then
+ * record the allocations made inside them. Without it the counters stay zero.
+ */
+namespace CKnot
+{
+
+    struct AllocCounters
+    {
+        size_t count; ///<Allocations made.
+        size_t bytes; ///<Bytes asked for.
+        long long live; ///<Bytes allocated minus bytes freed. Can go negative if another thread frees.
+        long long peak; ///<Highest live has been. Phases move this to track their own peaks.
+    };
+
+    AllocCounters& GetAllocCounters(); ///<Returns the counters for the calling thread.
+
+}
+
+#endif /*__ALLOC_HPP__*/
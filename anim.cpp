@@ -0,0 +1,232 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include "anim.hpp"
+#include <algorithm>
+
+#include <map>
+
+namespace CKnot
+{
+
+    namespace
+    {
+        const bool DrawGraph = false;
+    }
+
+
+    const double Engine::ResetTime = 30.0;
+    const double Engine::DrawTime = 20.0;
+
+
+    size_t Engine::GetKnotIndex(double time)
+    {
+        return time > 0.0 ? size_t(time / ResetTime) : 0;
+    }
+
+
+    unsigned int Engine::GetKnotSeed(unsigned int seed, size_t index)
+    {
+        //Murmur3 finalizer, so neighbouring knots get unrelated seeds.
+        unsigned int h = seed ^ (unsigned int)(index * 0x9e3779b9u);
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+
+    void Engine::GetClearColour(double time, float clear[3])
+    {
+        //Clear the background some nice color.
+        clear[0] = float(0.125f + std::sin(time / 2.0) / 8.0);
+        clear[1] = float(0.125f + std::sin(time / 3.0) / 8.0);
+        clear[2] = float(0.125f + std::sin(time / 5.0) / 8.0);
+    }
+
+
+    void Engine::GetFinishedColour(size_t index, float clear[3])
+    {
+        GetClearColour(index * ResetTime + DrawTime, clear);
+    }
+
+
+    void Engine::DrawFinished(Renderer& renderer, KnotMesh& mesh, size_t index, int width, int height, double pixelsPerSample)
+    {
+        float clear[3];
+        GetFinishedColour(index, clear);
+
+        const double aspect = double(width) / double(height);
+        renderer.Begin(width, height, clear, 0.0, aspect, 1.0, 0.0);
+
+        const Box view = {{0.0f, 0.0f}, {float(aspect), 1.0f}};
+        mesh.Draw(renderer, view, height, pixelsPerSample, 1.0);
+        renderer.End();
+    }
+
+
+    Engine::Engine(int width, int height, unsigned int seed)
+        :mTime(0.0), mArtTime(0.0), mSeed(seed), mKnot(0), mGenTime(0.0), mTaken(false), mPool(0), mSource(0),
+        mDetail(2.0), mFlowSpeed(0.0)
+    {
+        Resize(width, height);
+        mAspect = double(mWidth) / double(mHeight);
+    }
+
+
+    Engine::~Engine()
+    {
+    }
+
+
+    void Engine::Resize(int width, int height)
+    {
+        mWidth = width;
+        mHeight = height > 0 ? height : 1;
+    }
+
+
+    void Engine::NewArt(size_t index)
+    {
+        CKNOT_TRACE_SCOPE("new knot");
+
+        const double start = Stats::Now();
+
+        const unsigned int seed = GetKnotSeed(mSeed, index);
+        Random random(seed);
+
+        mAspect = double(mWidth) / double(mHeight);
+        mKnot = index;
+        mGrid.clear();
+
+        mArt.reset();
+        if (mSource)
+            mArt = mSource->Take(seed, mAspect, mLattice, random);
+        mTaken = mArt.get() != 0;
+
+        if (!mTaken)
+            MakeArt(random);
+
+        mMesh.Build(*mArt, random, &mArt->GetStats(), mPool);
+
+        if (mSource)
+            mSource->Prefetch(GetKnotSeed(mSeed, index + 1), mAspect, mLattice);
+
+        mGenTime = Stats::Now() - start;
+    }
+
+
+    void Engine::MakeArt(Random& random)
+    {
+        Stats stats;
+
+        StrokeList sl;
+        {
+            CKNOT_PHASE(&stats, PhaseStrokes);
+            sl = CreateSquareStrokes(random, mAspect, 1.0, mLattice);
+        }
+        {
+            CKNOT_PHASE(&stats, PhaseRemove);
+            sl = RemoveStrokes(random, sl, mLattice);
+        }
+
+        mArt = CreateThread(sl, &stats);
+
+        mGrid.reserve(sl.size() * 10);
+        for (StrokeList::const_iterator it = sl.begin(); it != sl.end(); ++it)
+        {
+            mGrid.push_back(it->a.x);
+            mGrid.push_back(it->a.y);
+            mGrid.push_back(it->type == Cross ? 1.0 : 0.0);
+            mGrid.push_back(it->type == Glance ? 1.0 : 0.0);
+            mGrid.push_back(it->type == Bounce ? 1.0 : 0.0);
+
+            mGrid.push_back(it->b.x);
+            mGrid.push_back(it->b.y);
+            mGrid.push_back(it->type == Cross ? 1.0 : 0.0);
+            mGrid.push_back(it->type == Glance ? 1.0 : 0.0);
+            mGrid.push_back(it->type == Bounce ? 1.0 : 0.0);
+        }
+    }
+
+
+    void Engine::SetTime(double time)
+    {
+        CKNOT_TRACE_SCOPE("update");
+
+        mTime = time;
+
+        //If we need new art, get it.
+        const size_t index = GetKnotIndex(mTime);
+        if (!mArt.get() || index != mKnot)
+            NewArt(index);
+
+        mArtTime = mTime - index * ResetTime;
+    }
+
+
+    RenderStats Engine::Render(Renderer& renderer, const Monitor* monitor) const
+    {
+        CKNOT_TRACE_SCOPE("render");
+
+        float clear[3];
+        GetClearColour(mTime, clear);
+
+        //The art is one unit high and starts at the origin. The camera picks the window's centre and scale.
+        const double aspect = double(mWidth) / double(mHeight);
+        const double halfHeight = 0.5 / mCamera.zoom;
+        const double halfWidth = aspect * halfHeight;
+        const double x = aspect / 2 + mCamera.panX;
+        const double y = 0.5 + mCamera.panY;
+
+        renderer.Begin(mWidth, mHeight, clear, x - halfWidth, x + halfWidth, y + halfHeight, y - halfHeight);
+
+        Box view;
+        view.min[0] = float(x - halfWidth);
+        view.min[1] = float(y - halfHeight);
+        view.max[0] = float(x + halfWidth);
+        view.max[1] = float(y + halfHeight);
+
+        //The bands repeat every period, so only how far into one they have moved matters.
+        Flow flow = mFlow;
+        if (flow.depth > 0.0f)
+            flow.offset = float(std::fmod(flow.offset + mArtTime * mFlowSpeed, double(flow.period)));
+        renderer.SetFlow(flow);
+
+        RenderStats stats = mMesh.Draw(renderer, view, mHeight * mCamera.zoom, mDetail, mArtTime / DrawTime, mPool);
+
+        //Draw graph
+        if (DrawGraph && !mGrid.empty())
+        {
+            renderer.DrawLines(&mGrid.front(), mGrid.size() / 5);
+            stats.vertices += mGrid.size() / 5;
+            ++stats.drawCalls;
+        }
+
+        //The overlay isn't part of the animation, so it isn't counted.
+        if (monitor)
+            monitor->Draw(renderer);
+
+        renderer.End();
+
+        return stats;
+    }
+
+}
@@ -0,0 +1,137 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ANIM_HPP__
+#define __ANIM_HPP__
+
+#include "cknot.hpp"
+#include "lattice.hpp"
+#include "mesh.hpp"
+#include "monitor.hpp"
+#include "render.hpp"
+
+namespace CKnot
+{
+
+    ///Which part of the art the window shows.
+    struct Camera
+    {
+        double panX, panY; ///<Where the window's centre is, in art units from the art's centre.
+        double zoom; ///<1 fits the art's height to the window, 2 shows half as much, and so on.
+
+        Camera():panX(0.0), panY(0.0), zoom(1.0){}
+    };
+
+
+    ///Somewhere knots may be made ahead of time, so the engine doesn't have to make them when they are due.
+    /**Knots are named by their seed, the aspect they were made for and their lattice. A knot from a source must
+     * be the one the engine would have made, and leave its random where making it would have.
+     */
+    class KnotSource
+    {
+        public:
+            virtual ~KnotSource(){}
+
+            ///Returns the knot and sets random to carry on after it, or returns null if the knot isn't ready.
+            virtual AutoArt Take(unsigned int seed, double aspect, const LatticeParams& lattice, Random& random) = 0;
+
+            ///Says a knot will be wanted soon. Called from NewArt, so must not take long.
+            virtual void Prefetch(unsigned int seed, double aspect, const LatticeParams& lattice) = 0;
+    };
+
+
+    ///The animation shared by every front-end. The caller owns the window and picks the renderer.
+    /**Engines don't share any state, so several may run at once, each on its own thread. A pool may be
+     * shared, but engines using it take turns at it.
+     * Each frame is a pure function of the seed, the window size and the time. The time is cut into
+     * ResetTime long slots, and the knot in each slot is made from a seed derived from its index.
+     * So any frame can be made without running the frames before it.
+     */
+    class Engine
+    {
+        public:
+            Engine(int width, int height, unsigned int seed);
+            ~Engine();
+
+            void Resize(int width, int height); ///<The current knot keeps its aspect, the next one picks up the new size.
+            void SetLattice(const LatticeParams& params) {mLattice = params;} ///<Sets the lattice used for new knots.
+            void SetPool(Pool* pool) {mPool = pool;} ///<Meshes new knots on pool, which must outlive the engine. Null meshes on the caller's thread.
+            void SetSource(KnotSource* source) {mSource = source;} ///<Takes new knots from source when it has them, which must outlive the engine. Null for none.
+            void SetCamera(const Camera& camera) {mCamera = camera;}
+            const Camera& GetCamera() const {return mCamera;}
+            void SetDetail(double pixelsPerSample) {mDetail = pixelsPerSample;} ///<Sets how far apart on screen ribbon samples may get before a coarser level of detail is used, 0 for always full detail. 2 to start with.
+            void SetFlow(const Flow& flow, double speed) {mFlow = flow; mFlowSpeed = speed;} ///<Sets bands to travel along the threads at speed art units a second. Off to start with.
+            const Flow& GetFlow() const {return mFlow;}
+
+            void Update(double dt) {SetTime(mTime + dt);} ///<Advances the animation by dt seconds.
+            void SetTime(double time); ///<Jumps to any time, making new art if it falls in another knot's slot.
+            double GetTime() const {return mTime;}
+            RenderStats Render(Renderer& renderer, const Monitor* monitor = 0) const; ///<Draws the current frame, with the monitor's overlay if given.
+
+            size_t GetKnot() const {return mKnot;} ///<Returns the index of the current knot.
+            const Stats& GetArtStats() const {return mArt->GetStats();} ///<Returns how the current knot was made. There must be one.
+            const Art& GetArt() const {return *mArt;} ///<Returns the current knot. There must be one.
+            double GetGenTime() const {return mGenTime;} ///<Returns the seconds it took to make the current knot.
+            bool IsKnotTaken() const {return mTaken;} ///<Returns true if the current knot came ready from the source.
+
+            static const double ResetTime; ///<Seconds each knot stays up.
+            static const double DrawTime; ///<Seconds taken to draw each knot in.
+
+            static size_t GetKnotIndex(double time); ///<Returns which knot slot a time falls in.
+            static unsigned int GetKnotSeed(unsigned int seed, size_t index); ///<Returns the seed used for a knot.
+
+            static void GetClearColour(double time, float clear[3]); ///<Returns the background at a time.
+            static void GetFinishedColour(size_t index, float clear[3]); ///<Returns the background once a knot is fully drawn in.
+
+            ///Draws a knot the way Render shows it once it is fully drawn in, for tools that make stills.
+            /**The whole knot fills the width by height frame, with levels of detail aiming for pixelsPerSample.
+             */
+            static void DrawFinished(Renderer& renderer, KnotMesh& mesh, size_t index, int width, int height, double pixelsPerSample);
+
+        private:
+            Engine(const Engine&);
+            Engine& operator=(const Engine&);
+
+            void NewArt(size_t index);
+            void MakeArt(Random& random); ///<Makes the current art and its grid from random.
+
+            int mWidth, mHeight; ///<Window size in pixels.
+            double mAspect; ///<Width of the art, its height is always 1.
+
+            double mTime; ///<Total time running.
+            double mArtTime; ///<Total time with the current art.
+
+            unsigned int mSeed; ///<Base seed, each knot's seed comes from this and its index.
+            size_t mKnot; ///<Index of the current art.
+            double mGenTime; ///<Seconds spent making the current art.
+            bool mTaken; ///<Whether the current art came from mSource.
+            LatticeParams mLattice;
+            Pool* mPool;
+            KnotSource* mSource;
+
+            AutoArt mArt;
+            mutable KnotMesh mMesh; ///<Ribbons of the current art, meshed as they are first drawn.
+            double mDetail; ///<Pixels per ribbon sample to aim for.
+            Flow mFlow;
+            double mFlowSpeed;
+            Camera mCamera;
+            FloatArray mGrid; ///<Lines of the stroke graph, empty for knots from a source.
+    };
+
+}
+
+#endif /*__ANIM_HPP__*/
@@ -0,0 +1,371 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Contact sheet renderer. Makes many knots as small thumbnails on every core and
+//packs them into atlas PNGs, a grid of thumbnails each, with an index saying
+//which knot is in each cell. Knots come from a range of seeds, optionally swept
+//over lattice densities and stroke type ratios. Drawing is all in software, so
+//it runs on servers with no display.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "anim.hpp"
+#include "png.hpp"
+#include "raster.hpp"
+
+namespace
+{
+    using namespace CKnot;
+
+    ///What goes in one cell of an atlas.
+    struct Cell
+    {
+        size_t knot; ///<Which of the screensaver's knots, with the same seed.
+        LatticeParams lattice;
+    };
+
+    ///One atlas image, filled in by whichever workers draw its cells.
+    struct Sheet
+    {
+        std::mutex lock; ///<Guards the fields below.
+        std::vector<unsigned char> pixels; ///<Empty until its first cell is drawn, and again once saved.
+        size_t remaining; ///<Cells not drawn yet.
+    };
+
+    ///Steps of a thumbnail, as WorkerStats numbers them. Encoding is of the atlases, which the last thumbnail in saves.
+    enum Step {StepMake, StepMesh, StepRaster, StepEncode};
+
+    struct Farm
+    {
+        unsigned int seed;
+        int width, height; ///<Of each thumbnail.
+        int columns, rows; ///<Thumbnails across and down each atlas.
+        double detail;
+        const char* outDir; ///<Null to encode without saving.
+
+        std::vector<Cell> cells;
+        std::vector<Sheet*> sheets;
+        std::atomic<size_t> claimed;
+        std::atomic<bool> failed;
+        std::vector<WorkerStats> stats;
+
+        size_t GetCellsPerSheet() const {return size_t(columns) * rows;}
+    };
+
+
+    ///Saves a finished atlas, then frees its pixels.
+    void Save(Farm& farm, size_t index, std::vector<unsigned char>& pixels)
+    {
+        const int width = farm.width * farm.columns, height = farm.height * farm.rows;
+
+        if (farm.outDir)
+        {
+            char path[4096];
+            std::snprintf(path, sizeof(path), "%s/atlas-%04lu.png", farm.outDir, (unsigned long)index);
+            if (!WritePNG(path, &pixels.front(), width, height))
+            {
+                std::fprintf(stderr, "cannot write %s\n", path);
+                farm.failed = true;
+            }
+        }
+        else
+        {
+            std::string png;
+            EncodePNG(&pixels.front(), width, height, png);
+        }
+
+        std::vector<unsigned char>().swap(pixels);
+    }
+
+    void Worker(Farm* farm, size_t worker)
+    {
+        WorkerStats ws;
+        SoftRenderer renderer;
+        KnotMesh mesh; //Kept from knot to knot, so its buffers are recycled.
+
+        const double aspect = double(farm->width) / double(farm->height);
+        const size_t rowBytes = size_t(farm->width) * 3;
+
+        for (;;)
+        {
+            const size_t index = farm->claimed.fetch_add(1);
+            if (index >= farm->cells.size())
+                break;
+
+            const Cell& cell = farm->cells[index];
+
+            double start = Stats::Now();
+            Random random(Engine::GetKnotSeed(farm->seed, cell.knot));
+            StrokeList strokes = CreateSquareStrokes(random, aspect, 1.0, cell.lattice);
+            strokes = RemoveStrokes(random, strokes, cell.lattice);
+            AutoArt art = CreateThread(strokes);
+
+            double now = Stats::Now();
+            ws.steps[StepMake] += now - start;
+            start = now;
+
+            mesh.Build(*art, random);
+
+            now = Stats::Now();
+            ws.steps[StepMesh] += now - start;
+            start = now;
+
+            Engine::DrawFinished(renderer, mesh, cell.knot, farm->width, farm->height, farm->detail);
+
+            now = Stats::Now();
+            ws.steps[StepRaster] += now - start;
+            ++ws.items;
+
+            //Copy the thumbnail into its cell. The last cell in saves the atlas.
+            const size_t sheetIndex = index / farm->GetCellsPerSheet();
+            const size_t slot = index % farm->GetCellsPerSheet();
+            const size_t left = (slot % farm->columns) * rowBytes;
+            const size_t top = (slot / farm->columns) * farm->height;
+            const size_t stride = rowBytes * farm->columns;
+
+            Sheet& sheet = *farm->sheets[sheetIndex];
+            std::vector<unsigned char> done;
+            {
+                std::lock_guard<std::mutex> hold(sheet.lock);
+                if (sheet.pixels.empty())
+                    sheet.pixels.assign(stride * farm->height * farm->rows, 0);
+
+                for (int y = 0; y < farm->height; ++y)
+                    std::memcpy(&sheet.pixels[(top + y) * stride + left], renderer.GetPixels() + y * rowBytes, rowBytes);
+
+                if (--sheet.remaining == 0)
+                    done.swap(sheet.pixels);
+            }
+
+            if (!done.empty())
+            {
+                start = Stats::Now();
+                Save(*farm, sheetIndex, done);
+                ws.steps[StepEncode] += Stats::Now() - start;
+            }
+        }
+
+        farm->stats[worker] = ws;
+    }
+
+    ///Writes which knot is in each cell of each atlas, as tab separated lines.
+    bool WriteIndex(const Farm& farm, const char* path)
+    {
+        FILE* f = std::fopen(path, "w");
+        if (!f)
+            return false;
+
+        std::fprintf(f, "atlas\tx\ty\twidth\theight\tknot\tseed\tdensity\tbounce\tglance\tremoval\n");
+        for (size_t i = 0; i < farm.cells.size(); ++i)
+        {
+            const Cell& cell = farm.cells[i];
+            const size_t slot = i % farm.GetCellsPerSheet();
+            std::fprintf(f, "atlas-%04lu.png\t%lu\t%lu\t%d\t%d\t%lu\t%u\t%g\t%g\t%g\t%g\n",
+                    (unsigned long)(i / farm.GetCellsPerSheet()),
+                    (unsigned long)(slot % farm.columns * farm.width), (unsigned long)(slot / farm.columns * farm.height),
+                    farm.width, farm.height, (unsigned long)cell.knot, Engine::GetKnotSeed(farm.seed, cell.knot),
+                    cell.lattice.junctionsPer, cell.lattice.bounce, cell.lattice.glance, cell.lattice.removal);
+        }
+
+        return std::fclose(f) == 0;
+    }
+
+    ///Reads a comma separated list of numbers.
+    bool ParseList(const char* s, std::vector<double>& out)
+    {
+        out.clear();
+        for (;;)
+        {
+            char* end;
+            const double v = std::strtod(s, &end);
+            if (end == s || v < 0.0)
+                return false;
+            out.push_back(v);
+            if (*end == '\0')
+                return true;
+            if (*end != ',')
+                return false;
+            s = end + 1;
+        }
+    }
+
+    void Usage(const char* argv0)
+    {
+        std::fprintf(stderr,
+                "usage: %s [-knots N] [-first N] [-seed N] [-thumb WxH] [-grid CxR] [-density LIST] [-bounce LIST] [-glance LIST] [-removal R] [-detail P] [-threads T] [-out DIR]\n"
+                "  -knots N       knots for each set of lattice parameters (default 256)\n"
+                "  -first N       index of the first knot, knot i matches the screensaver's i'th (default 0)\n"
+                "  -seed N        base seed (default 1)\n"
+                "  -thumb WxH     thumbnail size in pixels (default 160x90)\n"
+                "  -grid CxR      thumbnails across and down each atlas (default 16x16)\n"
+                "  -density LIST  comma separated lattice junctions per unit to sweep, 0 for random (default 10)\n"
+                "  -bounce LIST   chances of a stroke being a bounce to sweep (default 0.0667)\n"
+                "  -glance LIST   chances of a stroke being a glance to sweep (default 0.0667)\n"
+                "  -removal R     fraction of strokes removed, 0 for random (default 0)\n"
+                "  -detail P      pixels between ribbon samples before a coarser level of detail is used, 0 for none (default 2)\n"
+                "  -threads T     worker threads, 0 for one per core (default 0)\n"
+                "  -out DIR       save atlas-NNNN.png files and index.tsv in DIR, otherwise atlases are only encoded\n"
+                "Every combination of the swept values gets the same knots, in the order density, bounce, glance.\n",
+                argv0);
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    Farm farm;
+    farm.seed = 1;
+    farm.width = 160;
+    farm.height = 90;
+    farm.columns = 16;
+    farm.rows = 16;
+    farm.detail = 2.0;
+    farm.outDir = 0;
+
+    size_t knots = 256, first = 0;
+    int threads = 0;
+    LatticeParams base;
+    std::vector<double> densities(1, 10.0), bounces(1, base.bounce), glances(1, base.glance);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool ok = true;
+        if (!std::strcmp(argv[i], "-knots") && i + 1 < argc)
+            knots = std::strtoul(argv[++i], 0, 0);
+        else if (!std::strcmp(argv[i], "-first") && i + 1 < argc)
+            first = std::strtoul(argv[++i], 0, 0);
+        else if (!std::strcmp(argv[i], "-seed") && i + 1 < argc)
+            farm.seed = (unsigned int)std::strtoul(argv[++i], 0, 0);
+        else if (!std::strcmp(argv[i], "-thumb") && i + 1 < argc)
+            ok = std::sscanf(argv[++i], "%dx%d", &farm.width, &farm.height) == 2;
+        else if (!std::strcmp(argv[i], "-grid") && i + 1 < argc)
+            ok = std::sscanf(argv[++i], "%dx%d", &farm.columns, &farm.rows) == 2;
+        else if (!std::strcmp(argv[i], "-density") && i + 1 < argc)
+            ok = ParseList(argv[++i], densities);
+        else if (!std::strcmp(argv[i], "-bounce") && i + 1 < argc)
+            ok = ParseList(argv[++i], bounces);
+        else if (!std::strcmp(argv[i], "-glance") && i + 1 < argc)
+            ok = ParseList(argv[++i], glances);
+        else if (!std::strcmp(argv[i], "-removal") && i + 1 < argc)
+            base.removal = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-detail") && i + 1 < argc)
+            farm.detail = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-threads") && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "-out") && i + 1 < argc)
+            farm.outDir = argv[++i];
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (farm.width <= 0 || farm.height <= 0 || farm.columns <= 0 || farm.rows <= 0 || knots < 1 || threads < 0)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t d = 0; d < densities.size(); ++d)
+    {
+        for (size_t b = 0; b < bounces.size(); ++b)
+        {
+            for (size_t g = 0; g < glances.size(); ++g)
+            {
+                Cell cell;
+                cell.lattice = base;
+                cell.lattice.junctionsPer = densities[d];
+                cell.lattice.bounce = bounces[b];
+                cell.lattice.glance = glances[g];
+
+                for (size_t k = 0; k < knots; ++k)
+                {
+                    cell.knot = first + k;
+                    farm.cells.push_back(cell);
+                }
+            }
+        }
+    }
+
+    const size_t sheets = (farm.cells.size() + farm.GetCellsPerSheet() - 1) / farm.GetCellsPerSheet();
+    for (size_t s = 0; s < sheets; ++s)
+    {
+        farm.sheets.push_back(new Sheet);
+        farm.sheets.back()->remaining = std::min(farm.GetCellsPerSheet(), farm.cells.size() - s * farm.GetCellsPerSheet());
+    }
+
+    farm.claimed = 0;
+    farm.failed = false;
+    farm.stats.resize(threads);
+
+    const double start = Stats::Now();
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < threads; ++w)
+        workers.push_back(std::thread(Worker, &farm, size_t(w)));
+    for (size_t w = 0; w < workers.size(); ++w)
+        workers[w].join();
+
+    const double wall = Stats::Now() - start;
+
+    WorkerStats total;
+    for (size_t w = 0; w < farm.stats.size(); ++w)
+        total += farm.stats[w];
+
+    const double n = double(total.items);
+    const double busy = total.GetBusy();
+
+    std::printf("thumbnails    %lu (%dx%d, %lu atlases of %dx%d, seed %u, %d threads on %u cores)\n",
+            (unsigned long)total.items, farm.width, farm.height, (unsigned long)sheets, farm.columns, farm.rows,
+            farm.seed, threads, std::thread::hardware_concurrency());
+    std::printf("wall          %.3f s, %.1f thumbnails/s, %.1f per thread\n", wall, n / wall, n / wall / threads);
+    std::printf("busy          %.1f%% of thread time\n", 100.0 * busy / (wall * threads));
+    std::printf("ms/thumbnail  make %.3f  mesh %.3f  raster %.3f  encode %.3f\n",
+            total.steps[StepMake] / n * 1e3, total.steps[StepMesh] / n * 1e3, total.steps[StepRaster] / n * 1e3,
+            total.steps[StepEncode] / n * 1e3);
+
+    for (size_t s = 0; s < farm.sheets.size(); ++s)
+        delete farm.sheets[s];
+
+    if (farm.outDir)
+    {
+        char path[4096];
+        std::snprintf(path, sizeof(path), "%s/index.tsv", farm.outDir);
+        if (!WriteIndex(farm, path))
+        {
+            std::fprintf(stderr, "%s: cannot write %s\n", argv[0], path);
+            return 1;
+        }
+    }
+
+    return farm.failed ? 1 : 0;
+}
@@ -0,0 +1,399 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Batch renderer. Makes knots and saves each one fully drawn as a PNG, with every
+//step of the work its own pipeline stage: strokes, thread, mesh, raster and encode.
+//Stages hand knots on through small lock-free queues and each runs on as many
+//threads as asked. A stage that finds its input empty is starved and one that
+//finds its output full is blocked, which holds the faster stages back to the pace
+//of the slowest. The report shows where each stage's time went.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "anim.hpp"
+#include "png.hpp"
+#include "queue.hpp"
+#include "raster.hpp"
+
+namespace
+{
+    using namespace CKnot;
+
+    enum Stage
+    {
+        StageGenerate, ///<Strokes of the lattice, then removal.
+        StageThread, ///<Threads and splines.
+        StageMesh,
+        StageRaster,
+        StageEncode, ///<PNG encoding, and saving if asked.
+        StageCount
+    };
+
+    const char* const StageNames[StageCount] = {"generate", "thread", "mesh", "raster", "encode"};
+
+    ///One knot on its way through the pipeline. Each stage frees what the later ones don't need.
+    struct Job
+    {
+        size_t index;
+        Random random; ///<Carried from stage to stage, so knots match the screensaver's.
+        StrokeList strokes;
+        AutoArt art;
+        KnotMesh mesh;
+        std::vector<unsigned char> pixels;
+
+        Job():index(0){}
+    };
+
+    typedef BoundedQueue<Job*> JobQueue;
+
+    struct Batch
+    {
+        size_t count;
+        unsigned int seed;
+        int width, height;
+        LatticeParams lattice;
+        double detail; ///<Pixels per ribbon sample to aim for, 0 for full detail.
+        const char* outDir; ///<Null to encode without saving.
+
+        JobQueue* queues[StageCount - 1]; ///<queues[i] feeds stage i + 1.
+        std::atomic<size_t> claimed[StageCount]; ///<Knots each stage has taken on.
+        std::atomic<bool> failed;
+        std::vector<WorkerStats> stats[StageCount];
+    };
+
+    ///Spins, then yields, then sleeps, so a long wait doesn't burn a core another stage could use.
+    void Backoff(int& spins)
+    {
+        ++spins;
+        if (spins < 64)
+            return;
+        if (spins < 128)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    Job* Pop(JobQueue& queue, WorkerStats& ws)
+    {
+        Job* job;
+        if (queue.TryPop(job))
+            return job;
+
+        const double start = Stats::Now();
+        int spins = 0;
+        while (!queue.TryPop(job))
+            Backoff(spins);
+
+        ws.starved += Stats::Now() - start;
+        ++ws.starves;
+        return job;
+    }
+
+    void Push(JobQueue& queue, Job* job, WorkerStats& ws)
+    {
+        if (queue.TryPush(job))
+            return;
+
+        const double start = Stats::Now();
+        int spins = 0;
+        while (!queue.TryPush(job))
+            Backoff(spins);
+
+        ws.blocked += Stats::Now() - start;
+        ++ws.blocks;
+    }
+
+    void RunStage(Batch& batch, Stage stage, Job& job, SoftRenderer& renderer)
+    {
+        CKNOT_TRACE_SCOPE(StageNames[stage]);
+
+        switch (stage)
+        {
+            case StageGenerate:
+                job.random.Seed(Engine::GetKnotSeed(batch.seed, job.index));
+                job.strokes = CreateSquareStrokes(job.random, double(batch.width) / double(batch.height), 1.0, batch.lattice);
+                job.strokes = RemoveStrokes(job.random, job.strokes, batch.lattice);
+                break;
+
+            case StageThread:
+                job.art = CreateThread(job.strokes);
+                job.strokes.clear();
+                break;
+
+            case StageMesh:
+                job.mesh.Build(*job.art, job.random);
+                job.mesh.MeshAll();
+                job.art.reset();
+                break;
+
+            case StageRaster:
+                Engine::DrawFinished(renderer, job.mesh, job.index, batch.width, batch.height, batch.detail);
+                job.pixels.assign(renderer.GetPixels(), renderer.GetPixels() + size_t(batch.width) * batch.height * 3);
+                job.mesh.Clear();
+                break;
+
+            case StageEncode:
+                if (batch.outDir)
+                {
+                    char path[4096];
+                    std::snprintf(path, sizeof(path), "%s/knot-%05lu.png", batch.outDir, (unsigned long)job.index);
+                    if (!WritePNG(path, &job.pixels.front(), batch.width, batch.height))
+                    {
+                        std::fprintf(stderr, "cannot write %s\n", path);
+                        batch.failed = true;
+                    }
+                }
+                else
+                {
+                    std::string png;
+                    EncodePNG(&job.pixels.front(), batch.width, batch.height, png);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    void Worker(Batch* batch, Stage stage, size_t worker)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%s %lu", StageNames[stage], (unsigned long)worker);
+        Trace::SetThreadName(name);
+
+        WorkerStats ws;
+        SoftRenderer renderer; //Only the raster stage draws, but each of its workers needs its own.
+
+        //Exactly count knots pass each stage, so a worker that claims one is sure to get it.
+        for (;;)
+        {
+            const size_t index = batch->claimed[stage].fetch_add(1);
+            if (index >= batch->count)
+                break;
+
+            Job* job;
+            if (stage == StageGenerate)
+            {
+                job = new Job;
+                job->index = index;
+            }
+            else
+                job = Pop(*batch->queues[stage - 1], ws);
+
+            const double start = Stats::Now();
+            RunStage(*batch, stage, *job, renderer);
+            ws.steps[0] += Stats::Now() - start; //Each worker only runs its one stage.
+            ++ws.items;
+
+            if (stage + 1 < StageCount)
+                Push(*batch->queues[stage], job, ws);
+            else
+                delete job;
+        }
+
+        batch->stats[stage][worker] = ws;
+    }
+
+    ///Reads a comma separated worker count for each stage. A single number is used for every stage.
+    bool ParseWorkers(const char* s, int workers[StageCount])
+    {
+        int n = 0;
+        for (;;)
+        {
+            char* end;
+            const long v = std::strtol(s, &end, 10);
+            if (end == s || v < 1 || n == StageCount)
+                return false;
+            workers[n++] = int(v);
+            if (*end == '\0')
+                break;
+            if (*end != ',')
+                return false;
+            s = end + 1;
+        }
+
+        if (n == 1)
+            std::fill(workers + 1, workers + StageCount, workers[0]);
+        else if (n != StageCount)
+            return false;
+        return true;
+    }
+
+    void Usage(const char* argv0)
+    {
+        std::fprintf(stderr,
+                "usage: %s [-count N] [-size WxH] [-density J] [-seed N] [-detail P] [-workers W] [-queue Q] [-out DIR] [-trace FILE]\n"
+                "  -count N     knots to make (default 32)\n"
+                "  -size WxH    image size in pixels (default 640x360)\n"
+                "  -density J   lattice junctions per unit, 0 for random (default 10)\n"
+                "  -seed N      base seed, knot i matches the screensaver's i'th knot (default 1)\n"
+                "  -detail P    pixels between ribbon samples before a coarser level of detail is used, 0 for none (default 2)\n"
+                "  -workers W   threads per stage, either one count for all or generate,thread,mesh,raster,encode (default 1)\n"
+                "  -queue Q     knots each queue between stages holds (default 4)\n"
+                "  -out DIR     save knot-NNNNN.png files in DIR, otherwise they are only encoded\n"
+                "  -trace FILE  save a Chrome trace of the run (needs CKNOT_TRACE)\n",
+                argv0);
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    Batch batch;
+    batch.count = 32;
+    batch.seed = 1;
+    batch.width = 640;
+    batch.height = 360;
+    batch.lattice.junctionsPer = 10.0;
+    batch.detail = 2.0;
+    batch.outDir = 0;
+
+    int workers[StageCount];
+    std::fill(workers, workers + StageCount, 1);
+    long queue = 4;
+    const char* trace = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "-count") && i + 1 < argc)
+            batch.count = std::strtoul(argv[++i], 0, 0);
+        else if (!std::strcmp(argv[i], "-size") && i + 1 < argc)
+            std::sscanf(argv[++i], "%dx%d", &batch.width, &batch.height);
+        else if (!std::strcmp(argv[i], "-density") && i + 1 < argc)
+            batch.lattice.junctionsPer = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-seed") && i + 1 < argc)
+            batch.seed = (unsigned int)std::strtoul(argv[++i], 0, 0);
+        else if (!std::strcmp(argv[i], "-detail") && i + 1 < argc)
+            batch.detail = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-workers") && i + 1 < argc)
+        {
+            if (!ParseWorkers(argv[++i], workers))
+            {
+                Usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (!std::strcmp(argv[i], "-queue") && i + 1 < argc)
+            queue = std::atol(argv[++i]);
+        else if (!std::strcmp(argv[i], "-out") && i + 1 < argc)
+            batch.outDir = argv[++i];
+        else if (!std::strcmp(argv[i], "-trace") && i + 1 < argc)
+            trace = argv[++i];
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (batch.width <= 0 || batch.height <= 0 || queue < 1)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    for (int s = 0; s + 1 < StageCount; ++s)
+        batch.queues[s] = new JobQueue(size_t(queue));
+    for (int s = 0; s < StageCount; ++s)
+    {
+        batch.claimed[s] = 0;
+        batch.stats[s].resize(workers[s]);
+    }
+    batch.failed = false;
+
+    if (trace)
+    {
+        Trace::SetThreadName("batch");
+        Trace::Enable(true);
+    }
+
+    const double start = Stats::Now();
+
+    std::vector<std::thread> threads;
+    for (int s = 0; s < StageCount; ++s)
+        for (int w = 0; w < workers[s]; ++w)
+            threads.push_back(std::thread(Worker, &batch, Stage(s), size_t(w)));
+
+    //Sample how full each queue is while the workers run.
+    double fill[StageCount - 1] = {0.0};
+    size_t full[StageCount - 1] = {0};
+    size_t samples = 0;
+    while (batch.claimed[StageEncode].load() < batch.count + workers[StageEncode])
+    {
+        for (int s = 0; s + 1 < StageCount; ++s)
+        {
+            const size_t size = batch.queues[s]->GetSize();
+            fill[s] += double(size) / batch.queues[s]->GetCapacity();
+            full[s] += size >= batch.queues[s]->GetCapacity();
+        }
+        ++samples;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    const double wall = Stats::Now() - start;
+    Trace::Enable(false);
+
+    std::printf("knots         %lu (%dx%d, density %g, seed %u, queues of %lu)\n",
+            (unsigned long)batch.count, batch.width, batch.height, batch.lattice.junctionsPer, batch.seed,
+            (unsigned long)batch.queues[0]->GetCapacity());
+    std::printf("wall          %.3f s, %.1f knots/s\n", wall, batch.count / wall);
+    std::printf("\n%-9s %7s %9s %7s %8s %8s %7s %7s %10s\n",
+            "stage", "workers", "ms/knot", "busy%", "starved%", "blocked%", "starves", "blocks", "queue out");
+
+    for (int s = 0; s < StageCount; ++s)
+    {
+        WorkerStats total;
+        for (size_t w = 0; w < batch.stats[s].size(); ++w)
+            total += batch.stats[s][w];
+        const double busy = total.GetBusy();
+
+        //Percentages are of the stage's worker time, so busy% is its occupancy.
+        const double time = wall * workers[s];
+        char out[32] = "-";
+        if (s + 1 < StageCount && samples)
+            std::snprintf(out, sizeof(out), "%3.0f%% %3.0f%%F", 100.0 * fill[s] / samples, 100.0 * full[s] / samples);
+
+        std::printf("%-9s %7d %9.3f %7.1f %8.1f %8.1f %7lu %7lu %10s\n",
+                StageNames[s], workers[s], total.items ? busy / total.items * 1e3 : 0.0,
+                100.0 * busy / time, 100.0 * total.starved / time, 100.0 * total.blocked / time,
+                (unsigned long)total.starves, (unsigned long)total.blocks, out);
+    }
+    std::printf("\nqueue out is how full the stage's output queue was on average, and how often it was full (F).\n");
+
+    for (int s = 0; s + 1 < StageCount; ++s)
+        delete batch.queues[s];
+
+    if (trace && !Trace::Write(trace))
+    {
+        std::fprintf(stderr, "%s: cannot write %s\n", argv[0], trace);
+        return 1;
+    }
+
+    return batch.failed ? 1 : 0;
+}
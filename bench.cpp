@@ -0,0 +1,344 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Frame replay benchmark. Drives the engine on a virtual clock with the software
+//renderer and reports what each frame cost.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <time.h>
+
+#include "alloc.hpp"
+#include "anim.hpp"
+#include "buffer.hpp"
+#include "raster.hpp"
+#include "ribbon.hpp"
+#include "stock.hpp"
+
+#ifndef CKNOT_ALLOC_STATS
+#error celtic_bench needs CKNOT_ALLOC_STATS defined.
+#endif
+
+namespace
+{
+    ///Returns the CPU time of this thread and the engine's pool threads, leaving out the stock's and the tracer's.
+    double CpuTime(CKnot::Pool& pool)
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9 + pool.GetCpuTime();
+    }
+
+    ///Returns the allocations of the same threads CpuTime counts.
+    CKnot::AllocCounters GetAllocs(const CKnot::Pool& pool)
+    {
+        CKnot::AllocCounters c = pool.GetAllocCounters();
+        c.count += CKnot::GetAllocCounters().count;
+        c.bytes += CKnot::GetAllocCounters().bytes;
+        return c;
+    }
+
+    double WallTime()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+    }
+
+    ///Returns the p'th percentile of sorted values.
+    double Percentile(const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty())
+            return 0.0;
+        const size_t i = size_t(p / 100.0 * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(i, sorted.size() - 1)];
+    }
+
+    struct Frame
+    {
+        double cpu; ///<Seconds of CPU for update and render.
+        size_t vertices;
+        size_t allocs;
+        size_t allocBytes;
+        bool knotSwitch; ///<True if this frame made a new knot.
+    };
+
+    void PrintKnotStats(const CKnot::Engine& engine)
+    {
+        std::printf("{\"knot\":%lu,\"stats\":%s}\n", (unsigned long)engine.GetKnot(), engine.GetArtStats().ToJson().c_str());
+    }
+
+    void Usage(const char* argv0)
+    {
+        std::fprintf(stderr,
+                "usage: %s [-seconds S] [-fps F] [-size WxH] [-density J] [-seed N] [-threads T] [-kernel K] [-detail P] [-zoom Z] [-pan X,Y] [-flow V] [-out FILE.ppm] [-overlay] [-stats] [-trace FILE]\n"
+                "  -seconds S   simulated seconds to run (default 60)\n"
+                "  -fps F       virtual frame rate (default 60)\n"
+                "  -size WxH    frame size in pixels (default 1280x720)\n"
+                "  -density J   lattice junctions per unit, 0 for random (default 10)\n"
+                "  -seed N      base seed (default 1)\n"
+                "  -threads T   mesh new knots on T threads, 0 for one per core (default 1)\n"
+                "  -kernel K    ribbon kernel: scalar, sse or avx2 (default the best the CPU has)\n"
+                "  -detail P    pixels between ribbon samples before a coarser level of detail is used, 0 for none (default 2)\n"
+                "  -zoom Z      magnify the art Z times, culling what falls outside the window (default 1)\n"
+                "  -pan X,Y     move the window's centre X,Y art units from the art's (default 0,0)\n"
+                "  -flow V      run bands along the threads at V art units a second\n"
+                "  -stock DIR   take knots from a stock in DIR, as the screensaver does, and start on the one the last run readied\n"
+                "  -out FILE    save the last frame as a PPM\n"
+                "  -overlay     draw the frame statistics overlay, as the screensaver would\n"
+                "  -stats       print each knot's pipeline stats as a JSON line\n"
+                "  -trace FILE  save a Chrome trace of the run (needs CKNOT_TRACE)\n",
+                argv0);
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    const double startTime = WallTime();
+    double seconds = 60.0;
+    double fps = 60.0;
+    int width = 1280, height = 720;
+    double density = 10.0;
+    unsigned int seed = 1;
+    int threads = 1;
+    double detail = 2.0;
+    CKnot::Camera camera;
+    double flow = 0.0;
+    const char* out = 0;
+    bool stats = false;
+    bool overlay = false;
+    const char* trace = 0;
+    const char* stockDir = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "-seconds") && i + 1 < argc)
+            seconds = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-fps") && i + 1 < argc)
+            fps = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-size") && i + 1 < argc)
+            std::sscanf(argv[++i], "%dx%d", &width, &height);
+        else if (!std::strcmp(argv[i], "-density") && i + 1 < argc)
+            density = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-seed") && i + 1 < argc)
+            seed = (unsigned int)std::strtoul(argv[++i], 0, 0);
+        else if (!std::strcmp(argv[i], "-threads") && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "-kernel") && i + 1 < argc)
+        {
+            if (!CKnot::Ribbon::SetPath(argv[++i]))
+            {
+                std::fprintf(stderr, "%s: no %s kernel on this CPU\n", argv[0], argv[i]);
+                return 1;
+            }
+        }
+        else if (!std::strcmp(argv[i], "-detail") && i + 1 < argc)
+            detail = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-zoom") && i + 1 < argc)
+            camera.zoom = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-pan") && i + 1 < argc)
+            std::sscanf(argv[++i], "%lf,%lf", &camera.panX, &camera.panY);
+        else if (!std::strcmp(argv[i], "-flow") && i + 1 < argc)
+            flow = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-stock") && i + 1 < argc)
+            stockDir = argv[++i];
+        else if (!std::strcmp(argv[i], "-out") && i + 1 < argc)
+            out = argv[++i];
+        else if (!std::strcmp(argv[i], "-stats"))
+            stats = true;
+        else if (!std::strcmp(argv[i], "-overlay"))
+            overlay = true;
+        else if (!std::strcmp(argv[i], "-trace") && i + 1 < argc)
+            trace = argv[++i];
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (fps <= 0.0 || seconds <= 0.0 || width <= 0 || height <= 0 || threads < 0 || camera.zoom <= 0.0)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    CKnot::LatticeParams lattice;
+    lattice.junctionsPer = density;
+
+    std::unique_ptr<CKnot::KnotStock> stock;
+    if (stockDir)
+    {
+        stock.reset(new CKnot::KnotStock(stockDir));
+        seed = stock->Start(seed, double(width) / double(height), lattice);
+    }
+
+    CKnot::SoftRenderer renderer;
+    CKnot::Engine engine(width, height, seed);
+    CKnot::Monitor monitor;
+    engine.SetLattice(lattice);
+    engine.SetSource(stock.get());
+    engine.SetDetail(detail);
+    engine.SetCamera(camera);
+    if (flow != 0.0)
+    {
+        CKnot::Flow bands;
+        bands.depth = 0.6f;
+        engine.SetFlow(bands, flow);
+    }
+
+    CKnot::Pool pool(threads);
+    if (pool.GetThreadCount() > 1)
+        engine.SetPool(&pool);
+
+    const size_t frameCount = size_t(seconds * fps);
+    std::vector<Frame> frames;
+    frames.reserve(frameCount);
+
+    size_t knot = size_t(-1);
+    double firstFrame = 0.0;
+    bool firstTaken = false;
+
+    if (trace)
+    {
+        CKnot::Trace::SetThreadName("bench");
+        CKnot::Trace::Enable(true);
+    }
+
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        CKNOT_TRACE_SCOPE("frame");
+
+        const CKnot::AllocCounters before = GetAllocs(pool);
+        const double start = CpuTime(pool);
+
+        engine.SetTime(double(i) / fps);
+        const CKnot::RenderStats rs = engine.Render(renderer, overlay ? &monitor : 0);
+
+        Frame f;
+        f.cpu = CpuTime(pool) - start;
+
+        if (i == 0)
+        {
+            firstFrame = WallTime() - startTime;
+            firstTaken = engine.IsKnotTaken();
+        }
+
+        if (overlay)
+        {
+            CKnot::FrameSample sample;
+            sample.interval = 1.0 / fps;
+            sample.work = f.cpu;
+            sample.render = rs;
+            sample.knot = engine.GetKnot();
+            sample.genTime = engine.GetGenTime();
+            monitor.Add(sample);
+        }
+        f.vertices = rs.vertices;
+        const CKnot::AllocCounters after = GetAllocs(pool);
+        f.allocs = after.count - before.count;
+        f.allocBytes = after.bytes - before.bytes;
+        f.knotSwitch = engine.GetKnot() != knot;
+        frames.push_back(f);
+
+        if (stats && f.knotSwitch)
+            PrintKnotStats(engine);
+
+        knot = engine.GetKnot();
+    }
+
+    CKnot::Trace::Enable(false);
+
+    std::vector<double> all, steady, spikes;
+    size_t vertices = 0, maxVertices = 0;
+    size_t allocs = 0, maxAllocs = 0, steadyAllocs = 0;
+    size_t allocBytes = 0;
+
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        const Frame& f = frames[i];
+        all.push_back(f.cpu);
+        (f.knotSwitch ? spikes : steady).push_back(f.cpu);
+
+        vertices += f.vertices;
+        maxVertices = std::max(maxVertices, f.vertices);
+        allocs += f.allocs;
+        allocBytes += f.allocBytes;
+        maxAllocs = std::max(maxAllocs, f.allocs);
+        if (!f.knotSwitch)
+            steadyAllocs += f.allocs;
+    }
+
+    std::sort(all.begin(), all.end());
+    std::sort(steady.begin(), steady.end());
+    std::sort(spikes.begin(), spikes.end());
+
+    double spikeTotal = 0.0;
+    for (size_t i = 0; i < spikes.size(); ++i)
+        spikeTotal += spikes[i];
+
+    const double n = double(frames.size());
+
+    std::printf("frames             %lu (%.0f s at %.0f fps, %dx%d, density %g, seed %u, %lu threads, %s, detail %g, zoom %g, flow %g)\n",
+            (unsigned long)frames.size(), seconds, fps, width, height, density, seed, (unsigned long)pool.GetThreadCount(),
+            CKnot::Ribbon::GetName(CKnot::Ribbon::GetPath()), detail, camera.zoom, flow);
+    std::printf("counted            cpu time and allocations of the frame thread and %lu pool threads%s\n",
+            (unsigned long)pool.GetThreadCount() - 1, stock.get() ? ", not the stock's" : "");
+    std::printf("frame cpu ms       p50 %.3f  p99 %.3f  max %.3f\n",
+            Percentile(all, 50) * 1e3, Percentile(all, 99) * 1e3, all.back() * 1e3);
+    std::printf("steady cpu ms      p50 %.3f  p99 %.3f  max %.3f\n",
+            Percentile(steady, 50) * 1e3, Percentile(steady, 99) * 1e3, steady.empty() ? 0.0 : steady.back() * 1e3);
+    std::printf("knot switch ms     count %lu  mean %.3f  max %.3f\n",
+            (unsigned long)spikes.size(), spikes.empty() ? 0.0 : spikeTotal / spikes.size() * 1e3,
+            spikes.empty() ? 0.0 : spikes.back() * 1e3);
+    std::printf("first frame ms     %.3f from start, knot %s\n", firstFrame * 1e3, firstTaken ? "from the stock" : "made");
+    std::printf("vertices/frame     mean %.0f  max %lu\n", vertices / n, (unsigned long)maxVertices);
+    std::printf("allocs/frame       mean %.2f  max %lu  steady mean %.2f\n",
+            allocs / n, (unsigned long)maxAllocs, steady.empty() ? 0.0 : double(steadyAllocs) / steady.size());
+    std::printf("alloc bytes/frame  mean %.0f\n", allocBytes / n);
+
+    const CKnot::Buffers::Counters bc = CKnot::Buffers::GetCounters();
+    std::printf("mesh buffers       %lu taken, %lu recycled, %.1f MB mapped\n",
+            (unsigned long)bc.acquires, (unsigned long)bc.hits, bc.mappedBytes / 1048576.0);
+
+    if (stock.get())
+    {
+        const CKnot::KnotStock::Counters sc = stock->GetCounters();
+        std::printf("stock              %lu taken, %lu missed, %lu made ahead%s\n",
+                (unsigned long)sc.taken, (unsigned long)sc.missed, (unsigned long)sc.made,
+                stock->IsLocked() ? "" : ", in memory as another run has the folder");
+    }
+
+    if (out && !renderer.WritePPM(out))
+    {
+        std::fprintf(stderr, "%s: cannot write %s\n", argv[0], out);
+        return 1;
+    }
+
+    if (trace && !CKnot::Trace::Write(trace))
+    {
+        std::fprintf(stderr, "%s: cannot write %s\n", argv[0], trace);
+        return 1;
+    }
+
+    return 0;
+}
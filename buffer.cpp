@@ -0,0 +1,202 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "buffer.hpp"
+
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <stdint.h>
+#include <sys/mman.h>
+#endif
+
+namespace CKnot
+{
+
+    namespace Buffers
+    {
+        namespace
+        {
+            const int ClassCount = 8 * sizeof(size_t);
+
+            ///Everything is behind one lock, which is only taken once per buffer.
+            struct State
+            {
+                std::mutex lock;
+                std::vector<void*> free[ClassCount]; ///<Cached buffers of each size class.
+                size_t limit;
+                Counters counters;
+
+                State():limit(size_t(256) << 20)
+                {
+                    counters.acquires = counters.hits = counters.maps = 0;
+                    counters.mappedBytes = counters.cachedBytes = 0;
+                }
+            };
+
+            State& GetState()
+            {
+                static State state;
+                return state;
+            }
+
+            int GetClass(size_t bytes)
+            {
+                int c = 0;
+                while ((size_t(1) << c) < bytes)
+                    ++c;
+                return c;
+            }
+
+            void* Map(size_t size)
+            {
+#ifdef __linux__
+                if (size < HugeBytes)
+                {
+                    void* p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                    return p == MAP_FAILED ? 0 : p;
+                }
+
+                //Over-map by a huge page and trim both ends, so the buffer can be backed by whole huge pages.
+                const size_t span = size + HugeBytes;
+                char* p = static_cast<char*>(mmap(0, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+                if (p == MAP_FAILED)
+                    return 0;
+
+                char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + HugeBytes - 1) & ~uintptr_t(HugeBytes - 1));
+                if (aligned != p)
+                    munmap(p, aligned - p);
+                if (aligned + size != p + span)
+                    munmap(aligned + size, p + span - (aligned + size));
+
+                madvise(aligned, size, MADV_HUGEPAGE);
+                return aligned;
+#else
+                return std::malloc(size);
+#endif
+            }
+
+            void Unmap(void* p, size_t size)
+            {
+#ifdef __linux__
+                munmap(p, size);
+#else
+                (void)size;
+                std::free(p);
+#endif
+            }
+        }
+
+
+        void* Acquire(size_t bytes)
+        {
+            if (bytes < MinBytes)
+                return ::operator new(bytes);
+
+            const int c = GetClass(bytes);
+            const size_t size = size_t(1) << c;
+
+            State& state = GetState();
+            {
+                std::lock_guard<std::mutex> guard(state.lock);
+                ++state.counters.acquires;
+                if (!state.free[c].empty())
+                {
+                    void* p = state.free[c].back();
+                    state.free[c].pop_back();
+                    state.counters.cachedBytes -= size;
+                    ++state.counters.hits;
+                    return p;
+                }
+            }
+
+            void* p = Map(size);
+            if (!p)
+                throw std::bad_alloc();
+
+            std::lock_guard<std::mutex> guard(state.lock);
+            ++state.counters.maps;
+            state.counters.mappedBytes += size;
+            return p;
+        }
+
+
+        void Release(void* buffer, size_t bytes)
+        {
+            if (!buffer)
+                return;
+
+            if (bytes < MinBytes)
+            {
+                ::operator delete(buffer);
+                return;
+            }
+
+            const int c = GetClass(bytes);
+            const size_t size = size_t(1) << c;
+
+            State& state = GetState();
+            {
+                std::lock_guard<std::mutex> guard(state.lock);
+                if (state.counters.cachedBytes + size <= state.limit)
+                {
+                    state.free[c].push_back(buffer);
+                    state.counters.cachedBytes += size;
+                    return;
+                }
+                state.counters.mappedBytes -= size;
+            }
+
+            Unmap(buffer, size);
+        }
+
+
+        void SetLimit(size_t bytes)
+        {
+            State& state = GetState();
+            std::lock_guard<std::mutex> guard(state.lock);
+            state.limit = bytes;
+        }
+
+
+        void Trim()
+        {
+            State& state = GetState();
+            std::lock_guard<std::mutex> guard(state.lock);
+            for (int c = 0; c < ClassCount; ++c)
+            {
+                for (size_t i = 0; i < state.free[c].size(); ++i)
+                    Unmap(state.free[c][i], size_t(1) << c);
+
+                state.counters.mappedBytes -= state.free[c].size() << c;
+                state.free[c].clear();
+            }
+            state.counters.cachedBytes = 0;
+        }
+
+
+        Counters GetCounters()
+        {
+            State& state = GetState();
+            std::lock_guard<std::mutex> guard(state.lock);
+            return state.counters;
+        }
+    }
+
+}
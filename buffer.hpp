@@ -0,0 +1,88 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BUFFER_HPP__
+#define __BUFFER_HPP__
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace CKnot
+{
+
+    ///Recycles the big buffers meshes are written into, so a new knot reuses the last one's memory.
+    /**Requests are rounded up to a power of two from MinBytes, and freed buffers wait on a list for their size
+     * class until the next request of that class, or are unmapped if keeping them would pass the limit. On Linux
+     * each buffer is its own page aligned mapping, so the rounding only costs address space: pages past what is
+     * written are never touched. Buffers of HugeBytes and up are aligned to it and advised to use huge pages.
+     * Smaller requests go to operator new. Safe to use from any thread.
+     */
+    namespace Buffers
+    {
+        enum
+        {
+            MinBytes = 1 << 12, ///<Smallest size class, a page.
+            HugeBytes = 1 << 21 ///<Size of a huge page.
+        };
+
+        struct Counters
+        {
+            size_t acquires; ///<Buffers asked for, from MinBytes up.
+            size_t hits; ///<Of those, how many were recycled.
+            size_t maps; ///<How many needed new memory.
+            size_t mappedBytes; ///<Bytes held, handed out or cached.
+            size_t cachedBytes; ///<Bytes waiting for reuse.
+        };
+
+        void* Acquire(size_t bytes); ///<Returns a buffer of at least bytes, aligned for anything. Throws std::bad_alloc if there is no memory.
+        void Release(void* buffer, size_t bytes); ///<Gives a buffer back. bytes must be what it was acquired with.
+
+        void SetLimit(size_t bytes); ///<Sets the most bytes kept for reuse. 256 MB to start with.
+        void Trim(); ///<Frees every cached buffer.
+        Counters GetCounters();
+    }
+
+
+    ///Standard allocator drawing from Buffers.
+    /**Elements made without a value are left uninitialised rather than zeroed, so sizing a vector of floats
+     * only to overwrite every one costs nothing.
+     */
+    template <typename T>
+    class BufferAllocator
+    {
+        public:
+            typedef T value_type;
+
+            BufferAllocator(){}
+            template <typename U> BufferAllocator(const BufferAllocator<U>&){}
+
+            T* allocate(size_t n) {return static_cast<T*>(Buffers::Acquire(n * sizeof(T)));}
+            void deallocate(T* p, size_t n) {Buffers::Release(p, n * sizeof(T));}
+
+            template <typename U> void construct(U* p) {::new(static_cast<void*>(p)) U;}
+            template <typename U, typename... Args> void construct(U* p, Args&&... args) {::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);}
+
+            template <typename U> struct rebind {typedef BufferAllocator<U> other;};
+    };
+
+    template <typename T, typename U> bool operator==(const BufferAllocator<T>&, const BufferAllocator<U>&) {return true;}
+    template <typename T, typename U> bool operator!=(const BufferAllocator<T>&, const BufferAllocator<U>&) {return false;}
+
+}
+
+#endif /*__BUFFER_HPP__*/
@@ -0,0 +1,368 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace CKnot
+{
+
+    namespace
+    {
+        ///What disk tier files start with: a tag and version, then the key, little endian.
+        std::string GetHeader(KnotCache::Key key)
+        {
+            std::string header("CKNB\1\0\0\0", 8);
+            for (int i = 0; i < 8; ++i)
+                header += char((key >> (i * 8)) & 0xff);
+            return header;
+        }
+    }
+
+
+    Hash& Hash::Add(const void* data, size_t size)
+    {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            mHash ^= p[i];
+            mHash *= 1099511628211ULL;
+        }
+        return *this;
+    }
+
+
+    Hash& Hash::Add(const char* s)
+    {
+        return Add(s, std::strlen(s) + 1);
+    }
+
+
+    Blob::~Blob()
+    {
+#ifdef __linux__
+        if (mMap)
+            munmap(mMap, mMapSize);
+#endif
+    }
+
+
+    Blob* Blob::Load(const char* path, const std::string& header)
+    {
+#ifdef __linux__
+        const int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return 0;
+
+        struct stat st;
+        void* map = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && size_t(st.st_size) > header.size())
+            map = mmap(0, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (map == MAP_FAILED)
+            return 0;
+
+        if (std::memcmp(map, header.data(), header.size()))
+        {
+            munmap(map, size_t(st.st_size));
+            return 0;
+        }
+
+        Blob* blob = new Blob;
+        blob->mMap = map;
+        blob->mMapSize = size_t(st.st_size);
+        blob->mStart = static_cast<const char*>(map) + header.size();
+        blob->mSize = blob->mMapSize - header.size();
+        return blob;
+#else
+        FILE* f = std::fopen(path, "rb");
+        if (!f)
+            return 0;
+
+        std::string data;
+        char chunk[65536];
+        size_t n;
+        while ((n = std::fread(chunk, 1, sizeof chunk, f)) > 0)
+            data.append(chunk, n);
+        std::fclose(f);
+
+        if (data.size() <= header.size() || data.compare(0, header.size(), header))
+            return 0;
+        return new Blob(data.substr(header.size()));
+#endif
+    }
+
+
+    KnotCache::KnotCache(size_t budget, const char* dir, size_t diskBudget)
+        :mShardBudget(budget / Shards), mDir(dir ? dir : ""), mDiskBudget(diskBudget), mDiskBytes(0), mDiskEvictions(0)
+    {
+        if (!mDir.empty())
+            Scan();
+    }
+
+
+    KnotCache::BlobPtr KnotCache::Get(Key key)
+    {
+        Shard& shard = GetShard(key);
+        {
+            std::lock_guard<std::mutex> hold(shard.lock);
+            const std::unordered_map<Key, List::iterator>::iterator it = shard.index.find(key);
+            if (it != shard.index.end())
+            {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                ++shard.hits;
+                return it->second->second;
+            }
+        }
+
+        //Map the file without the lock, so other keys of the shard aren't held up by the disk.
+        BlobPtr blob;
+        if (!mDir.empty())
+            blob.reset(Blob::Load(GetPath(key).c_str(), GetHeader(key)));
+
+        std::lock_guard<std::mutex> hold(shard.lock);
+        if (!blob)
+        {
+            ++shard.misses;
+            return blob;
+        }
+
+        ++shard.diskHits;
+        Insert(shard, key, blob);
+        return blob;
+    }
+
+
+    KnotCache::BlobPtr KnotCache::Put(Key key, const std::string& data)
+    {
+        const BlobPtr blob(new Blob(data));
+        if (!mDir.empty())
+            Save(key, data);
+
+        Shard& shard = GetShard(key);
+        std::lock_guard<std::mutex> hold(shard.lock);
+        ++shard.puts;
+        Insert(shard, key, blob);
+        return blob;
+    }
+
+
+    void KnotCache::Remove(Key key)
+    {
+        if (!mDir.empty())
+        {
+            std::lock_guard<std::mutex> hold(mDiskLock);
+            std::remove(GetPath(key).c_str());
+            Forget(key);
+        }
+
+        Shard& shard = GetShard(key);
+        std::lock_guard<std::mutex> hold(shard.lock);
+        const std::unordered_map<Key, List::iterator>::iterator it = shard.index.find(key);
+        if (it != shard.index.end())
+        {
+            shard.bytes -= it->second->second->GetSize();
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+    }
+
+
+    void KnotCache::Insert(Shard& shard, Key key, const BlobPtr& blob)
+    {
+        //Another thread may have got here first with the same key. Its blob holds the same bytes.
+        const std::unordered_map<Key, List::iterator>::iterator it = shard.index.find(key);
+        if (it != shard.index.end())
+        {
+            shard.bytes -= it->second->second->GetSize();
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+
+        shard.lru.push_front(std::make_pair(key, blob));
+        shard.index[key] = shard.lru.begin();
+        shard.bytes += blob->GetSize();
+
+        //The newest blob stays even if it is over the budget alone.
+        while (shard.bytes > mShardBudget && shard.lru.size() > 1)
+        {
+            const List::iterator last = --shard.lru.end();
+            shard.bytes -= last->second->GetSize();
+            shard.index.erase(last->first);
+            shard.lru.erase(last);
+            ++shard.evictions;
+        }
+    }
+
+
+    std::string KnotCache::GetPath(Key key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof name, "/%016llx.knot", key);
+        return mDir + name;
+    }
+
+
+    void KnotCache::Save(Key key, const std::string& data)
+    {
+        //Threads saving the same key each write their own temporary file, and the last rename wins.
+        const std::string path = GetPath(key);
+        char suffix[64];
+        std::snprintf(suffix, sizeof suffix, ".%lu.tmp", (unsigned long)std::hash<std::thread::id>()(std::this_thread::get_id()));
+        const std::string temp = path + suffix;
+
+        FILE* f = std::fopen(temp.c_str(), "wb");
+        if (!f)
+            return;
+
+        const std::string header = GetHeader(key);
+        const bool ok = std::fwrite(header.data(), 1, header.size(), f) == header.size() &&
+            std::fwrite(data.data(), 1, data.size(), f) == data.size();
+
+        if (std::fclose(f) != 0 || !ok)
+        {
+            std::remove(temp.c_str());
+            return;
+        }
+
+        //Renamed under the lock, so the accounting always matches what's there.
+        std::lock_guard<std::mutex> hold(mDiskLock);
+        if (std::rename(temp.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temp.c_str());
+            return;
+        }
+
+        Forget(key);
+        mFiles.push_back(std::make_pair(key, header.size() + data.size()));
+        mFileIndex[key] = --mFiles.end();
+        mDiskBytes += mFiles.back().second;
+        Trim();
+    }
+
+
+    void KnotCache::Trim()
+    {
+        //The newest file stays even if it is over the budget alone.
+        while (mDiskBudget && mDiskBytes > mDiskBudget && mFiles.size() > 1)
+        {
+            const Key oldest = mFiles.front().first;
+            std::remove(GetPath(oldest).c_str());
+            Forget(oldest);
+            ++mDiskEvictions;
+        }
+    }
+
+
+    void KnotCache::Forget(Key key)
+    {
+        const std::unordered_map<Key, FileList::iterator>::iterator it = mFileIndex.find(key);
+        if (it == mFileIndex.end())
+            return;
+
+        mDiskBytes -= it->second->second;
+        mFiles.erase(it->second);
+        mFileIndex.erase(it);
+    }
+
+
+    void KnotCache::Scan()
+    {
+#ifdef __linux__
+        DIR* dir = opendir(mDir.c_str());
+        if (!dir)
+            return;
+
+        //Files named as GetPath names them, by when they were written.
+        struct File
+        {
+            double written;
+            Key key;
+            size_t size;
+
+            bool operator<(const File& rhs) const {return written < rhs.written;}
+        };
+        std::vector<File> files;
+
+        while (const dirent* entry = readdir(dir))
+        {
+            char* end;
+            const Key key = std::strtoull(entry->d_name, &end, 16);
+            struct stat st;
+            if (end != entry->d_name + 16 || std::strcmp(end, ".knot") || stat((mDir + "/" + entry->d_name).c_str(), &st) != 0)
+                continue;
+
+            const File file = {double(st.st_mtim.tv_sec) + double(st.st_mtim.tv_nsec) / 1e9, key, size_t(st.st_size)};
+            files.push_back(file);
+        }
+        closedir(dir);
+
+        std::stable_sort(files.begin(), files.end());
+
+        std::lock_guard<std::mutex> hold(mDiskLock);
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            mFiles.push_back(std::make_pair(files[i].key, files[i].size));
+            mFileIndex[files[i].key] = --mFiles.end();
+            mDiskBytes += files[i].size;
+        }
+        Trim();
+#endif
+    }
+
+
+    KnotCache::Counters KnotCache::GetCounters() const
+    {
+        Counters c;
+        std::memset(&c, 0, sizeof c);
+
+        for (int i = 0; i < Shards; ++i)
+        {
+            const Shard& shard = mShards[i];
+            std::lock_guard<std::mutex> hold(shard.lock);
+            c.hits += shard.hits;
+            c.diskHits += shard.diskHits;
+            c.misses += shard.misses;
+            c.puts += shard.puts;
+            c.evictions += shard.evictions;
+            c.entries += shard.lru.size();
+            c.bytes += shard.bytes;
+        }
+
+        std::lock_guard<std::mutex> hold(mDiskLock);
+        c.diskEvictions = mDiskEvictions;
+        c.diskEntries = mFiles.size();
+        c.diskBytes = mDiskBytes;
+        return c;
+    }
+
+}
@@ -0,0 +1,159 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CACHE_HPP__
+#define __CACHE_HPP__
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace CKnot
+{
+
+    ///64 bit FNV-1a, for keys made of a few fields.
+    /**Fields are hashed as their bytes, so build keys from fixed size types in a fixed order.
+     */
+    class Hash
+    {
+        public:
+            Hash():mHash(14695981039346656037ULL){}
+
+            Hash& Add(const void* data, size_t size);
+            Hash& Add(unsigned int v) {return Add(&v, sizeof v);}
+            Hash& Add(unsigned long long v) {return Add(&v, sizeof v);}
+            Hash& Add(double v) {return Add(&v, sizeof v);}
+            Hash& Add(const char* s); ///<Adds a string and its terminator, so "a", "bc" and "ab", "c" differ.
+
+            unsigned long long Get() const {return mHash;}
+
+        private:
+            unsigned long long mHash;
+    };
+
+
+    ///Bytes held by the cache, either in memory or mapped from a file.
+    class Blob
+    {
+        public:
+            explicit Blob(const std::string& data):mData(data), mMap(0), mMapSize(0), mStart(mData.data()), mSize(mData.size()){}
+            ~Blob();
+
+            ///Maps a file, or reads it where there is no mmap, as the bytes after a header it must start with. Returns null if it can't or doesn't.
+            static Blob* Load(const char* path, const std::string& header);
+
+            const char* GetData() const {return mStart;}
+            size_t GetSize() const {return mSize;}
+            bool IsMapped() const {return mMap != 0;}
+
+        private:
+            Blob():mMap(0), mMapSize(0), mStart(0), mSize(0){}
+            Blob(const Blob&);
+            Blob& operator=(const Blob&);
+
+            std::string mData;
+            void* mMap;
+            size_t mMapSize;
+            const char* mStart;
+            size_t mSize;
+    };
+
+
+    ///Keeps what was made from a key so it needn't be made again, in memory and optionally on disk.
+    /**Keys are hashes of whatever the value was made from, see Hash. The memory tier is split into Shards by
+     * key, each with its own lock, least recently used list and share of the byte budget, so threads looking
+     * up different keys rarely wait for each other. A miss in memory looks for a file named by the key in
+     * the disk tier. The file is mapped rather than read, and the mapping goes into the memory tier.
+     * Files are written under a temporary name, then renamed into place, so a reader never finds half of
+     * one, and start with a header naming their key. The disk tier can have a byte budget of its own. The
+     * files already there are totted up at construction, oldest first by modification time, and each save
+     * that takes the total over deletes the oldest until it fits. Files are in the order they were written,
+     * not used, as the memory tier keeps what's in use. Without a budget the disk tier is only trimmed by
+     * Remove. Blobs stay valid for as long as someone holds them, even once evicted or deleted.
+     */
+    class KnotCache
+    {
+        public:
+            typedef unsigned long long Key;
+            typedef std::shared_ptr<const Blob> BlobPtr;
+
+            enum {Shards = 16};
+
+            struct Counters
+            {
+                size_t hits; ///<Gets found in memory.
+                size_t diskHits; ///<Gets found on disk.
+                size_t misses;
+                size_t puts;
+                size_t evictions; ///<Blobs dropped from memory to stay in budget.
+                size_t entries, bytes; ///<Held in memory now.
+                size_t diskEvictions; ///<Files deleted to keep the disk tier in budget.
+                size_t diskEntries, diskBytes; ///<Held on disk now, as far as this cache knows.
+            };
+
+            ///Keeps up to budget bytes in memory. With a directory, which must exist, blobs are saved there too,
+            ///up to diskBudget bytes of files, or without limit for 0.
+            explicit KnotCache(size_t budget, const char* dir = 0, size_t diskBudget = 0);
+
+            BlobPtr Get(Key key); ///<Returns the blob for key, or null.
+            BlobPtr Put(Key key, const std::string& data); ///<Stores data under key, returning it as a blob.
+            void Remove(Key key); ///<Drops key from memory and disk. Blobs already handed out stay valid.
+
+            Counters GetCounters() const;
+
+        private:
+            KnotCache(const KnotCache&);
+            KnotCache& operator=(const KnotCache&);
+
+            typedef std::list<std::pair<Key, BlobPtr> > List; ///<Most recently used first.
+            typedef std::list<std::pair<Key, size_t> > FileList; ///<Files and their sizes, oldest first.
+
+            struct Shard
+            {
+                mutable std::mutex lock; ///<Guards the fields below.
+                List lru;
+                std::unordered_map<Key, List::iterator> index;
+                size_t bytes;
+                size_t hits, diskHits, misses, puts, evictions;
+
+                Shard():bytes(0), hits(0), diskHits(0), misses(0), puts(0), evictions(0){}
+            };
+
+            Shard& GetShard(Key key) {return mShards[(key >> 60) & (Shards - 1)];}
+            void Insert(Shard& shard, Key key, const BlobPtr& blob); ///<Needs the shard's lock.
+            std::string GetPath(Key key) const;
+            void Save(Key key, const std::string& data);
+            void Scan(); ///<Finds the files already in the disk tier.
+            void Forget(Key key); ///<Drops a file from the disk tier's accounting. Needs mDiskLock.
+            void Trim(); ///<Deletes the oldest files until the disk tier is in budget. Needs mDiskLock.
+
+            Shard mShards[Shards];
+            size_t mShardBudget;
+            std::string mDir; ///<Empty for no disk tier.
+
+            mutable std::mutex mDiskLock; ///<Guards the fields below, and renaming files into place.
+            FileList mFiles;
+            std::unordered_map<Key, FileList::iterator> mFileIndex;
+            size_t mDiskBudget, mDiskBytes, mDiskEvictions;
+    };
+
+}
+
+#endif /*__CACHE_HPP__*/
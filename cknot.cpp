@@ -141,6 +141,30 @@ namespace CKnot
     }
 
 
+    Spline::LookupStats Art::GetLookupStats() const
+    {
+        Spline::LookupStats ret;
+
+        for (SplineVector::const_iterator it = mThreads.begin(); it != mThreads.end(); ++it)
+            ret += (*it)->GetLookupStats();
+
+        for (ZVector::const_iterator it = mZs.begin(); it != mZs.end(); ++it)
+            ret += (*it)->GetLookupStats();
+
+        return ret;
+    }
+
+
+    void Art::ClearLookupStats() const
+    {
+        for (SplineVector::const_iterator it = mThreads.begin(); it != mThreads.end(); ++it)
+            (*it)->ClearLookupStats();
+
+        for (ZVector::const_iterator it = mZs.begin(); it != mZs.end(); ++it)
+            (*it)->ClearLookupStats();
+    }
+
+
     namespace
     {
         struct Junction;
@@ -266,7 +290,7 @@ namespace CKnot
             NodeSet unused; ///<Unused nodes.
             JunctionMap junctions; ///<Junction position lookup.
 
-            Graph(const StrokeList& strokes)
+            void Build(const StrokeList& strokes)
             {
                 for (StrokeList::const_iterator it = strokes.begin(); it != strokes.end(); ++it)
                 {
@@ -313,14 +337,12 @@ namespace CKnot
                         n.dir = bRight;
                         unused.insert(n);
                     }
-
-
-                    {//Sort junctions.
-                        for (JunctionMap::const_iterator it = junctions.begin(); it != junctions.end(); ++it)
-                            it->second->mids.sort(VecAngleComp(it->second->position));
-                    }
                 }
 
+                {//Sort junctions.
+                    for (JunctionMap::const_iterator it = junctions.begin(); it != junctions.end(); ++it)
+                        it->second->mids.sort(VecAngleComp(it->second->position));
+                }
             }
 
             ~Graph()
@@ -330,29 +352,71 @@ namespace CKnot
                 junctions.clear();
             }
         };
+
+        ///The points of one thread, found while walking the graph.
+        struct ThreadPoints
+        {
+            std::vector<vec2> points;
+            std::vector<vec2> angles;
+            std::vector<double> zs;
+        };
+
+        ///Builds the splines for each traced thread.
+        AutoArt BuildArt(const std::vector<ThreadPoints>& traced, Stats* stats)
+        {
+            Art::SplineVector ret;
+            Art::ZVector retZs;
+
+            {
+                CKNOT_PHASE(stats, PhaseSplines);
+
+                for (size_t i = 0; i < traced.size(); ++i)
+                {
+                    const ThreadPoints& tp = traced[i];
+
+                    const size_t frames = tp.points.size() - 1; ///<Count up for each node visited.
+                    double* xs = new double[frames + 1];
+                    for (size_t i = 0; i < frames; ++i)
+                        xs[i] = double(i) / double(frames);
+                    xs[frames] = 1.0;
+
+                    ret.push_back(new Art::Thread(xs, &tp.points.front(), &tp.angles.front(), frames + 1, true));
+                    retZs.push_back(new Art::Z(xs, &tp.zs.front(), frames + 1, true));
+
+                    delete[] xs;
+
+                    CKNOT_COUNT(stats, CountKnots, frames + 1);
+                }
+            }
+
+            CKNOT_COUNT(stats, CountThreads, ret.size());
+
+            AutoArt art(new Art(ret, retZs));
+            if (stats)
+                art->GetStats() = *stats;
+            return art;
+        }
     }
 
 
-    AutoArt CreateThread(const StrokeList& strokes)
+    ///Walks the graph, filling in the points of each thread it finds.
+    static void TraceThreads(Graph& g, std::vector<ThreadPoints>& traced)
     {
         const double rot = std::atan(1.0); //45 degrees.
 
-        Graph g(strokes);
-
-        Art::SplineVector ret;
-        Art::ZVector retZs;
-
         NodeSet unusedUp; //Stores cross type nodes that have been crossed but are unused.
 
         while (g.unused.size() || unusedUp.size())
         {
-            std::vector<vec2> thread;
+            traced.push_back(ThreadPoints());
+
+            std::vector<vec2>& thread = traced.back().points;
             thread.reserve(g.unused.size() + 1);
 
-            std::vector<vec2> angles;
+            std::vector<vec2>& angles = traced.back().angles;
             angles.reserve(thread.capacity());
 
-            std::vector<double> zs;
+            std::vector<double>& zs = traced.back().zs;
             zs.reserve(thread.capacity());
 
             bool up = false; //Over or under?
@@ -492,23 +556,37 @@ namespace CKnot
             }
 
 
-            const size_t frames = thread.size(); ///<Count up for each node visited.
-            double* xs = new double[frames + 1];
-            for (size_t i = 0; i < frames; ++i)
-                xs[i] = double(i) / double(frames);
-            xs[frames] = 1.0;
-
             thread.push_back(thread.front());
             angles.push_back(angles.front());
             zs.push_back(zs.front());
 
-            ret.push_back(new Art::Thread(xs, &thread.front(), &angles.front(), frames + 1, true));
-            retZs.push_back(new Art::Z(xs, &zs.front(), frames + 1, true));
+            //Give back the spare room, every thread is kept until the splines are built.
+            std::vector<vec2>(thread).swap(thread);
+            std::vector<vec2>(angles).swap(angles);
+            std::vector<double>(zs).swap(zs);
+        }
+    }
+
 
-            delete[] xs;
+    AutoArt CreateThread(const StrokeList& strokes, Stats* stats)
+    {
+        Graph g;
+        {
+            CKNOT_PHASE(stats, PhaseGraph);
+            g.Build(strokes);
+        }
+
+        CKNOT_COUNT(stats, CountStrokes, strokes.size());
+        CKNOT_COUNT(stats, CountJunctions, g.junctions.size());
+        CKNOT_COUNT(stats, CountNodes, g.unused.size());
+
+        std::vector<ThreadPoints> traced;
+        {
+            CKNOT_PHASE(stats, PhaseTrace);
+            TraceThreads(g, traced);
         }
 
-        return AutoArt(new Art(ret, retZs));
+        return BuildArt(traced, stats);
     }
 
 }
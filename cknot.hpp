@@ -22,6 +22,7 @@
 #include <memory>
 #include <vector>
 #include "spline.hpp"
+#include "stats.hpp"
 
 namespace CKnot
 {
@@ -82,14 +83,25 @@ namespace CKnot
             const Thread* GetThread(size_t index) const;
             const Z* GetZ(size_t index) const;
 
+            Stats& GetStats() {return mStats;} ///<Returns how long this art took to make.
+            const Stats& GetStats() const {return mStats;}
+
+            Spline::LookupStats GetLookupStats() const; ///<Adds up the lookups of all the thread and z splines.
+            void ClearLookupStats() const; ///<Zeroes the lookups of all the thread and z splines.
+
         private:
             SplineVector mThreads;
             ZVector mZs;
+            Stats mStats;
     };
 
     typedef std::auto_ptr<Art> AutoArt;
 
-    AutoArt CreateThread(const StrokeList& strokes); ///<Given a stroke list, creates a thread running through them. The caller should delete the splines.
+    ///Given a stroke list, creates a thread running through them. The caller should delete the splines.
+    /**If stats is given, the graph, trace and spline phases are added to it. The art gets a copy of the result,
+     * so a caller can time the phases before this one into the same stats.
+     */
+    AutoArt CreateThread(const StrokeList& strokes, Stats* stats = 0);
 }
 
 #endif /*__CKNOT_HPP__*/
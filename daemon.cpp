@@ -0,0 +1,817 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Knot rendering service. Listens on a Unix domain socket and renders knots on
+//request, as PNG, SVG or binary Art, on a pool of workers that stay warm between
+//requests: their renderers, meshes and buffers are kept, and each draws a knot
+//before the socket opens. Requests queue earliest deadline first, workers take
+//them a batch at a time and render identical requests in a batch once, and
+//requests still queued at their deadline are answered with an error unrendered.
+//A cache keeps finished images and the knots they were drawn from, in memory and
+//optionally on disk, so repeated requests, or new sizes and formats of a knot
+//already made, skip the work.
+//
+//The protocol is a line per request, answered in order on each connection:
+//
+//  render [seed=N] [knot=N] [size=WxH] [density=J] [format=png|svg|art] [deadline=MS]
+//  metrics
+//  ping
+//
+//Answers are "ok BYTES TYPE" and a newline, then BYTES bytes of body, or
+//"error REASON" and a newline. Metrics come back as a line of JSON.
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "anim.hpp"
+#include "cache.hpp"
+#include "export.hpp"
+#include "png.hpp"
+#include "raster.hpp"
+
+namespace
+{
+    using namespace CKnot;
+
+    volatile sig_atomic_t Quit = 0;
+
+    void OnSignal(int)
+    {
+        Quit = 1;
+    }
+
+    enum Format {FormatPNG, FormatSVG, FormatArt, FormatCount};
+
+    const char* const FormatNames[FormatCount] = {"png", "svg", "art"};
+    const char* const FormatTypes[FormatCount] = {"image/png", "image/svg+xml", "application/x-celtic-art"};
+
+    ///What to render. Requests with equal keys get the same bytes back.
+    struct Key
+    {
+        unsigned int seed;
+        size_t knot;
+        int width, height;
+        double density;
+        Format format;
+
+        bool operator<(const Key& rhs) const
+        {
+            if (seed != rhs.seed)
+                return seed < rhs.seed;
+            if (knot != rhs.knot)
+                return knot < rhs.knot;
+            if (width != rhs.width)
+                return width < rhs.width;
+            if (height != rhs.height)
+                return height < rhs.height;
+            if (density != rhs.density)
+                return density < rhs.density;
+            return format < rhs.format;
+        }
+
+        bool operator==(const Key& rhs) const {return !(*this < rhs) && !(rhs < *this);}
+
+        ///Hashes what the knot is made from. The size only matters through the aspect.
+        KnotCache::Key GetKnotHash() const
+        {
+            return Hash().Add("knot").Add(Engine::GetKnotSeed(seed, knot)).Add(double(width) / double(height)).Add(density).Get();
+        }
+
+        KnotCache::Key GetHash() const
+        {
+            return Hash().Add(FormatNames[format]).Add(GetKnotHash()).Add((unsigned int)width).Add((unsigned int)height).Get();
+        }
+    };
+
+    struct Request
+    {
+        Key key;
+        double arrival, deadline; ///<Seconds on Stats::Now's clock.
+        double started; ///<When a worker took it.
+
+        bool done; ///<Set under the server's lock once body or error is.
+        std::string body;
+        const char* error;
+
+        Request():arrival(0.0), deadline(0.0), started(0.0), done(false), error(0){}
+    };
+
+    ///Keeps the most recent samples of a latency.
+    class Latencies
+    {
+        public:
+            enum {Size = 4096};
+
+            Latencies():mNext(0){}
+
+            void Add(double seconds)
+            {
+                if (mSamples.size() < Size)
+                    mSamples.push_back(seconds);
+                else
+                    mSamples[mNext++ % Size] = seconds;
+            }
+
+            ///Returns "{"p50":...,"p99":...,"max":...}" in milliseconds.
+            std::string ToJson() const
+            {
+                std::vector<double> sorted(mSamples);
+                std::sort(sorted.begin(), sorted.end());
+
+                char buf[128];
+                std::snprintf(buf, sizeof buf, "{\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+                        Percentile(sorted, 50) * 1e3, Percentile(sorted, 99) * 1e3, sorted.empty() ? 0.0 : sorted.back() * 1e3);
+                return buf;
+            }
+
+        private:
+            static double Percentile(const std::vector<double>& sorted, double p)
+            {
+                if (sorted.empty())
+                    return 0.0;
+                const size_t i = size_t(p / 100.0 * (sorted.size() - 1) + 0.5);
+                return sorted[std::min(i, sorted.size() - 1)];
+            }
+
+            std::vector<double> mSamples;
+            size_t mNext;
+    };
+
+    class Server
+    {
+        public:
+            ///Returns once every worker has drawn its warm-up knot.
+            Server(size_t workers, size_t batch, size_t maxQueue, KnotCache* cache);
+            ~Server();
+
+            ///Queues a request. Returns false, with the request answered, if the queue is full.
+            bool Submit(Request* request);
+            void Wait(Request* request); ///<Returns once the request is answered.
+
+            std::string GetMetrics() const;
+
+        private:
+            void Work(size_t self);
+            void Render(const Key& key, SoftRenderer& renderer, KnotMesh& mesh, std::string& out);
+            void Finish(Request* request, double now);
+
+            std::vector<std::thread> mThreads;
+            size_t mWorkers, mBatch, mMaxQueue;
+            KnotCache* mCache; ///<Null for none.
+            double mStart;
+
+            mutable std::mutex mLock; ///<Guards everything below.
+            std::condition_variable mWork, mDone;
+            std::multimap<double, Request*> mQueue; ///<By deadline, then arrival.
+            size_t mWarm; ///<Workers done warming up.
+            bool mQuit;
+
+            //Metrics.
+            size_t mRequests[FormatCount];
+            size_t mRendered, mFailed, mCoalesced, mExpired, mRejected, mBatches, mMaxDepth;
+            Latencies mWait, mRender, mTotal;
+    };
+
+
+    Server::Server(size_t workers, size_t batch, size_t maxQueue, KnotCache* cache)
+        :mWorkers(workers), mBatch(batch), mMaxQueue(maxQueue), mCache(cache), mStart(Stats::Now()), mWarm(0), mQuit(false),
+        mRendered(0), mFailed(0), mCoalesced(0), mExpired(0), mRejected(0), mBatches(0), mMaxDepth(0)
+    {
+        std::fill(mRequests, mRequests + FormatCount, 0);
+        for (size_t i = 0; i < workers; ++i)
+            mThreads.push_back(std::thread(&Server::Work, this, i));
+
+        std::unique_lock<std::mutex> hold(mLock);
+        while (mWarm < workers)
+            mDone.wait(hold);
+    }
+
+
+    Server::~Server()
+    {
+        {
+            std::lock_guard<std::mutex> hold(mLock);
+            mQuit = true;
+        }
+        mWork.notify_all();
+
+        for (size_t i = 0; i < mThreads.size(); ++i)
+            mThreads[i].join();
+    }
+
+
+    bool Server::Submit(Request* request)
+    {
+        {
+            std::lock_guard<std::mutex> hold(mLock);
+            ++mRequests[request->key.format];
+
+            if (mQueue.size() >= mMaxQueue)
+            {
+                ++mRejected;
+                request->error = "busy";
+                request->done = true;
+                return false;
+            }
+
+            mQueue.insert(std::make_pair(request->deadline, request));
+            mMaxDepth = std::max(mMaxDepth, mQueue.size());
+        }
+
+        mWork.notify_one();
+        return true;
+    }
+
+
+    void Server::Wait(Request* request)
+    {
+        std::unique_lock<std::mutex> hold(mLock);
+        while (!request->done)
+            mDone.wait(hold);
+    }
+
+
+    void Server::Finish(Request* request, double now)
+    {
+        //Called with mLock held.
+        request->done = true;
+        mWait.Add(request->started - request->arrival);
+        mTotal.Add(now - request->arrival);
+    }
+
+
+    void Server::Render(const Key& key, SoftRenderer& renderer, KnotMesh& mesh, std::string& out)
+    {
+        KnotCache::BlobPtr blob;
+        if (mCache && (blob = mCache->Get(key.GetHash())))
+        {
+            out.assign(blob->GetData(), blob->GetSize());
+            return;
+        }
+
+        const double aspect = double(key.width) / double(key.height);
+        Random random(Engine::GetKnotSeed(key.seed, key.knot));
+        AutoArt art;
+
+        //The knot may be cached from another size or format.
+        if (mCache && (blob = mCache->Get(key.GetKnotHash())))
+            art = DecodeKnot(blob->GetData(), blob->GetSize(), random);
+
+        if (!art.get())
+        {
+            LatticeParams lattice;
+            lattice.junctionsPer = key.density;
+
+            StrokeList strokes = CreateSquareStrokes(random, aspect, 1.0, lattice);
+            strokes = RemoveStrokes(random, strokes, lattice);
+            art = CreateThread(strokes);
+
+            if (mCache)
+            {
+                std::string knot;
+                EncodeKnot(*art, random, knot);
+                mCache->Put(key.GetKnotHash(), knot);
+            }
+        }
+
+        switch (key.format)
+        {
+            case FormatPNG:
+                mesh.Build(*art, random);
+                Engine::DrawFinished(renderer, mesh, key.knot, key.width, key.height, 2.0);
+                EncodePNG(renderer.GetPixels(), key.width, key.height, out);
+                break;
+
+            case FormatSVG:
+            {
+                float clear[3];
+                Engine::GetFinishedColour(key.knot, clear);
+                EncodeSVG(*art, random, aspect, clear, key.width, key.height, out);
+                break;
+            }
+
+            default:
+                EncodeArt(*art, out);
+                break;
+        }
+
+        if (mCache)
+            mCache->Put(key.GetHash(), out);
+    }
+
+
+    void Server::Work(size_t self)
+    {
+        //Each worker keeps its renderer and mesh, so requests after the first find their buffers ready.
+        SoftRenderer renderer;
+        KnotMesh mesh;
+        std::vector<Request*> batch;
+
+        {
+            const Key warm = {1, 0, 160, 90, 10.0, FormatPNG};
+            std::string out;
+            Render(warm, renderer, mesh, out);
+
+            std::lock_guard<std::mutex> hold(mLock);
+            ++mWarm;
+        }
+        mDone.notify_all();
+
+        for (;;)
+        {
+            batch.clear();
+            {
+                std::unique_lock<std::mutex> hold(mLock);
+                while (mQueue.empty() && !mQuit)
+                    mWork.wait(hold);
+                if (mQueue.empty())
+                    return;
+
+                //The earliest deadlines, and anything queued for the same render. A short queue is shared out
+                //rather than taken whole, so the other workers get some of it.
+                const double now = Stats::Now();
+                const size_t take = std::min(mBatch, std::max<size_t>(1, mQueue.size() / mWorkers));
+                while (!mQueue.empty() && batch.size() < take)
+                {
+                    batch.push_back(mQueue.begin()->second);
+                    batch.back()->started = now;
+                    mQueue.erase(mQueue.begin());
+                }
+                for (std::multimap<double, Request*>::iterator it = mQueue.begin(); it != mQueue.end();)
+                {
+                    bool same = false;
+                    for (size_t i = 0; i < batch.size() && !same; ++i)
+                        same = batch[i]->key == it->second->key;
+
+                    if (same)
+                    {
+                        batch.push_back(it->second);
+                        batch.back()->started = now;
+                        mQueue.erase(it++);
+                    }
+                    else
+                        ++it;
+                }
+                ++mBatches;
+            }
+
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                Request* request = batch[i];
+                if (request->done)
+                    continue;
+
+                const double start = Stats::Now();
+                if (start > request->deadline)
+                {
+                    std::lock_guard<std::mutex> hold(mLock);
+                    request->error = "deadline";
+                    ++mExpired;
+                    Finish(request, start);
+                    continue;
+                }
+
+                //A render that throws, say out of memory, fails its request rather than the daemon.
+                try
+                {
+                    Render(request->key, renderer, mesh, request->body);
+                }
+                catch (...)
+                {
+                    request->body.clear();
+                    request->error = "render failed";
+                }
+                const double end = Stats::Now();
+
+                std::lock_guard<std::mutex> hold(mLock);
+                mRender.Add(end - start);
+                if (request->error)
+                    ++mFailed;
+                else
+                    ++mRendered;
+                Finish(request, end);
+
+                //Later requests in the batch for the same render share the result.
+                for (size_t j = i + 1; j < batch.size(); ++j)
+                {
+                    if (!batch[j]->done && batch[j]->key == request->key)
+                    {
+                        batch[j]->body = request->body;
+                        batch[j]->error = request->error;
+                        ++mCoalesced;
+                        Finish(batch[j], end);
+                    }
+                }
+            }
+
+            mDone.notify_all();
+        }
+    }
+
+
+    std::string Server::GetMetrics() const
+    {
+        std::lock_guard<std::mutex> hold(mLock);
+
+        char buf[512];
+        std::snprintf(buf, sizeof buf,
+                "{\"uptime\":%.3f,\"workers\":%lu,\"requests\":{\"png\":%lu,\"svg\":%lu,\"art\":%lu},"
+                "\"rendered\":%lu,\"failed\":%lu,\"coalesced\":%lu,\"expired\":%lu,\"rejected\":%lu,\"batches\":%lu,"
+                "\"queue\":{\"depth\":%lu,\"max\":%lu,\"limit\":%lu},",
+                Stats::Now() - mStart, (unsigned long)mWorkers, (unsigned long)mRequests[FormatPNG],
+                (unsigned long)mRequests[FormatSVG], (unsigned long)mRequests[FormatArt], (unsigned long)mRendered,
+                (unsigned long)mFailed, (unsigned long)mCoalesced, (unsigned long)mExpired, (unsigned long)mRejected, (unsigned long)mBatches,
+                (unsigned long)mQueue.size(), (unsigned long)mMaxDepth, (unsigned long)mMaxQueue);
+
+        std::string json = std::string(buf) + "\"waitMs\":" + mWait.ToJson() + ",\"renderMs\":" + mRender.ToJson() +
+            ",\"totalMs\":" + mTotal.ToJson();
+
+        if (mCache)
+        {
+            const KnotCache::Counters c = mCache->GetCounters();
+            std::snprintf(buf, sizeof buf, ",\"cache\":{\"hits\":%lu,\"diskHits\":%lu,\"misses\":%lu,\"evictions\":%lu,\"entries\":%lu,\"bytes\":%lu,"
+                    "\"disk\":{\"evictions\":%lu,\"entries\":%lu,\"bytes\":%lu}}",
+                    (unsigned long)c.hits, (unsigned long)c.diskHits, (unsigned long)c.misses, (unsigned long)c.evictions,
+                    (unsigned long)c.entries, (unsigned long)c.bytes, (unsigned long)c.diskEvictions, (unsigned long)c.diskEntries,
+                    (unsigned long)c.diskBytes);
+            json += buf;
+        }
+
+        return json + "}";
+    }
+
+
+    ///The connections being served, so they can be cut off on the way out.
+    struct Clients
+    {
+        std::mutex lock;
+        std::condition_variable gone;
+        std::set<int> fds;
+    };
+
+    enum {MaxSize = 8192};
+    ///Lattice junctions beyond which a knot takes too long or too much memory to make: density 100 at up to 2:1.
+    const double MaxJunctions = 20000.0;
+    const double RandomDensity = 14.0; ///<The most CreateSquareStrokes picks for a density of 0.
+
+    ///Reads a render line's fields into key and the deadline. Returns false on anything it doesn't know.
+    bool ParseRender(const std::string& line, Key& key, double& deadline)
+    {
+        key.seed = 1;
+        key.knot = 0;
+        key.width = 640;
+        key.height = 360;
+        key.density = 10.0;
+        key.format = FormatPNG;
+        deadline = 0.0;
+
+        size_t pos = line.find(' ');
+        while (pos != std::string::npos)
+        {
+            const size_t start = line.find_first_not_of(' ', pos);
+            if (start == std::string::npos)
+                break;
+            pos = line.find(' ', start);
+            const std::string field = line.substr(start, pos == std::string::npos ? std::string::npos : pos - start);
+
+            const size_t eq = field.find('=');
+            if (eq == std::string::npos)
+                return false;
+            const std::string name = field.substr(0, eq);
+            const char* value = field.c_str() + eq + 1;
+
+            if (name == "seed")
+                key.seed = (unsigned int)std::strtoul(value, 0, 0);
+            else if (name == "knot")
+                key.knot = std::strtoul(value, 0, 0);
+            else if (name == "size")
+            {
+                if (std::sscanf(value, "%dx%d", &key.width, &key.height) != 2)
+                    return false;
+            }
+            else if (name == "density")
+                key.density = std::atof(value);
+            else if (name == "deadline")
+                deadline = std::atof(value) / 1e3;
+            else if (name == "format")
+            {
+                int f = 0;
+                while (f < FormatCount && std::strcmp(value, FormatNames[f]))
+                    ++f;
+                if (f == FormatCount)
+                    return false;
+                key.format = Format(f);
+            }
+            else
+                return false;
+        }
+
+        if (key.width <= 0 || key.height <= 0 || key.width > MaxSize || key.height > MaxSize || !(key.density >= 0.0))
+            return false;
+
+        //The lattice is density by density times the aspect, so a long thin image needs many more junctions.
+        const double density = key.density > 0.0 ? key.density : RandomDensity;
+        const double aspect = double(key.width) / double(key.height);
+        return density * density * std::max(aspect, 1.0 / aspect) <= MaxJunctions;
+    }
+
+    bool WriteAll(int fd, const char* data, size_t size)
+    {
+        while (size)
+        {
+            const ssize_t n = write(fd, data, size);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            data += n;
+            size -= size_t(n);
+        }
+        return true;
+    }
+
+    bool Answer(int fd, const Request& request, const char* type)
+    {
+        if (request.error)
+        {
+            const std::string line = std::string("error ") + request.error + "\n";
+            return WriteAll(fd, line.data(), line.size());
+        }
+
+        char head[128];
+        std::snprintf(head, sizeof head, "ok %lu %s\n", (unsigned long)request.body.size(), type);
+        return WriteAll(fd, head, std::strlen(head)) && WriteAll(fd, request.body.data(), request.body.size());
+    }
+
+    ///Serves one client. Every complete line read is queued before any is waited on, so a client sending
+    ///several requests at once has them rendered together.
+    void Serve(Server* server, Clients* clients, int fd)
+    {
+        std::string buffer;
+        char chunk[4096];
+        std::vector<Request*> pending;
+        std::vector<const char*> types;
+
+        for (;;)
+        {
+            const ssize_t n = read(fd, chunk, sizeof chunk);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            buffer.append(chunk, size_t(n));
+
+            size_t end;
+            while ((end = buffer.find('\n')) != std::string::npos)
+            {
+                std::string line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                if (!line.empty() && line[line.size() - 1] == '\r')
+                    line.erase(line.size() - 1);
+
+                Request* request = new Request;
+                request->arrival = Stats::Now();
+                const char* type = "text/plain";
+
+                double deadline;
+                if (line == "ping")
+                    request->done = true;
+                else if (line == "metrics")
+                {
+                    request->body = server->GetMetrics();
+                    request->done = true;
+                    type = "application/json";
+                }
+                else if (line.compare(0, 7, "render ") == 0 || line == "render")
+                {
+                    if (ParseRender(line, request->key, deadline))
+                    {
+                        request->deadline = deadline > 0.0 ? request->arrival + deadline : 1e300;
+                        type = FormatTypes[request->key.format];
+                        server->Submit(request);
+                    }
+                    else
+                    {
+                        request->error = "bad request";
+                        request->done = true;
+                    }
+                }
+                else
+                {
+                    request->error = "unknown command";
+                    request->done = true;
+                }
+
+                pending.push_back(request);
+                types.push_back(type);
+            }
+
+            bool ok = true;
+            for (size_t i = 0; i < pending.size(); ++i)
+            {
+                server->Wait(pending[i]);
+                ok = ok && Answer(fd, *pending[i], types[i]);
+                delete pending[i];
+            }
+            pending.clear();
+            types.clear();
+
+            if (!ok)
+                break;
+        }
+
+        std::lock_guard<std::mutex> hold(clients->lock);
+        close(fd);
+        clients->fds.erase(fd);
+        clients->gone.notify_all();
+    }
+
+    ///Sends one line to a running daemon and writes the body of its answer to stdout.
+    int Send(const char* path, const char* line)
+    {
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof addr);
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path, sizeof addr.sun_path - 1);
+
+        if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+        {
+            std::fprintf(stderr, "cannot connect to %s: %s\n", path, std::strerror(errno));
+            return 1;
+        }
+
+        const std::string request = std::string(line) + "\n";
+        WriteAll(fd, request.data(), request.size());
+        shutdown(fd, SHUT_WR);
+
+        std::string answer;
+        char chunk[65536];
+        ssize_t n;
+        while ((n = read(fd, chunk, sizeof chunk)) > 0)
+            answer.append(chunk, size_t(n));
+        close(fd);
+
+        const size_t eol = answer.find('\n');
+        if (eol == std::string::npos || answer.compare(0, 3, "ok ") != 0)
+        {
+            std::fprintf(stderr, "%s\n", answer.substr(0, eol).c_str());
+            return 1;
+        }
+
+        std::fprintf(stderr, "%s\n", answer.substr(0, eol).c_str());
+        std::fwrite(answer.data() + eol + 1, 1, answer.size() - eol - 1, stdout);
+        return 0;
+    }
+
+    void Usage(const char* argv0)
+    {
+        std::fprintf(stderr,
+                "usage: %s [-socket PATH] [-workers N] [-batch B] [-queue Q] [-cache MB] [-cache-dir DIR] [-cache-dir-mb MB] [-send LINE]\n"
+                "  -socket PATH  Unix domain socket to listen on (default /tmp/celtic_knots.sock)\n"
+                "  -workers N    render threads, 0 for one per core (default 0)\n"
+                "  -batch B      requests a worker takes at a time (default 8)\n"
+                "  -queue Q      requests that may wait before more are turned away as busy (default 256)\n"
+                "  -cache MB     megabytes of knots and images to keep in memory, 0 for no cache (default 64)\n"
+                "  -cache-dir D  also keep them as files in D, which must exist, to map again after a restart\n"
+                "  -cache-dir-mb MB\n"
+                "                megabytes of files to keep in D, the oldest deleted first, 0 for no limit (default 1024)\n"
+                "  -send LINE    send LINE to a running daemon and write the answer's body to stdout\n",
+                argv0);
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    const char* path = "/tmp/celtic_knots.sock";
+    int workers = 0;
+    long batch = 8, queue = 256;
+    const char* send = 0;
+    double cacheMB = 64.0;
+    const char* cacheDir = 0;
+    double cacheDirMB = 1024.0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "-socket") && i + 1 < argc)
+            path = argv[++i];
+        else if (!std::strcmp(argv[i], "-workers") && i + 1 < argc)
+            workers = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "-batch") && i + 1 < argc)
+            batch = std::atol(argv[++i]);
+        else if (!std::strcmp(argv[i], "-queue") && i + 1 < argc)
+            queue = std::atol(argv[++i]);
+        else if (!std::strcmp(argv[i], "-cache") && i + 1 < argc)
+            cacheMB = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-cache-dir") && i + 1 < argc)
+            cacheDir = argv[++i];
+        else if (!std::strcmp(argv[i], "-cache-dir-mb") && i + 1 < argc)
+            cacheDirMB = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-send") && i + 1 < argc)
+            send = argv[++i];
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (workers < 0 || batch < 1 || queue < 1 || cacheMB < 0.0 || cacheDirMB < 0.0 || std::strlen(path) >= sizeof(sockaddr_un().sun_path))
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    if (send)
+        return Send(path, send);
+
+    if (workers == 0)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    //Workers warm up before the socket opens, so the first client doesn't pay for it.
+    KnotCache* cache = cacheMB > 0.0 || cacheDir ? new KnotCache(size_t(cacheMB * 1024 * 1024), cacheDir, size_t(cacheDirMB * 1024 * 1024)) : 0;
+    Server server((size_t)workers, (size_t)batch, (size_t)queue, cache);
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof addr);
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path, sizeof addr.sun_path - 1);
+    unlink(path);
+
+    if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof addr) < 0 || listen(listener, 64) < 0)
+    {
+        std::fprintf(stderr, "%s: cannot listen on %s: %s\n", argv[0], path, std::strerror(errno));
+        return 1;
+    }
+
+    std::fprintf(stderr, "listening on %s with %d workers\n", path, workers);
+
+    //Poll with a timeout so a signal is noticed promptly.
+    Clients clients;
+    while (!Quit)
+    {
+        pollfd p = {listener, POLLIN, 0};
+        if (poll(&p, 1, 200) <= 0)
+            continue;
+
+        const int fd = accept(listener, 0, 0);
+        if (fd < 0)
+            continue;
+
+        std::lock_guard<std::mutex> hold(clients.lock);
+        clients.fds.insert(fd);
+        std::thread(Serve, &server, &clients, fd).detach();
+    }
+
+    close(listener);
+    unlink(path);
+
+    //Clients still connected are cut off. Their threads answer what they have queued, then end once reads fail.
+    {
+        std::unique_lock<std::mutex> hold(clients.lock);
+        for (std::set<int>::const_iterator it = clients.fds.begin(); it != clients.fds.end(); ++it)
+            shutdown(*it, SHUT_RDWR);
+        while (!clients.fds.empty())
+            clients.gone.wait(hold);
+    }
+
+    std::fprintf(stderr, "%s\n", server.GetMetrics().c_str());
+    return 0;
+}
@@ -0,0 +1,262 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "export.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "mesh.hpp"
+
+namespace CKnot
+{
+
+    namespace
+    {
+        ///Bezier control points of half of a segment.
+        struct Half
+        {
+            vec2 p[4];
+        };
+
+        ///Splits a thread's segment in two at t = .5.
+        void Split(const Art::Thread& thread, size_t segment, Half halves[2])
+        {
+            const vec2 p0 = thread.GetKnotY(segment);
+            const vec2 p3 = thread.GetKnotY(segment + 1);
+            const vec2 p1 = p0 + thread.GetKnotM(segment) * (1.0 / 3.0);
+            const vec2 p2 = p3 - thread.GetKnotM(segment + 1) * (1.0 / 3.0);
+
+            const vec2 a = (p0 + p1) * 0.5, b = (p1 + p2) * 0.5, c = (p2 + p3) * 0.5;
+            const vec2 d = (a + b) * 0.5, e = (b + c) * 0.5;
+            const vec2 m = (d + e) * 0.5;
+
+            const Half first = {{p0, a, d, m}};
+            const Half second = {{m, e, c, p3}};
+            halves[0] = first;
+            halves[1] = second;
+        }
+
+        void AppendColour(std::string& out, const float c[3])
+        {
+            char buf[16];
+            std::snprintf(buf, sizeof buf, "#%02x%02x%02x", int(c[0] * 255.0f + 0.5f),
+                    int(c[1] * 255.0f + 0.5f), int(c[2] * 255.0f + 0.5f));
+            out += buf;
+        }
+
+        ///Adds a path of the run of halves from first to end, in both strokes of the thread.
+        void AppendRun(std::string& out, const Half* halves, size_t first, size_t end, const SegmentMesh::Thread& run)
+        {
+            std::string d;
+            char buf[160];
+            std::snprintf(buf, sizeof buf, "M%.5g %.5g", halves[first].p[0].x, halves[first].p[0].y);
+            d += buf;
+            for (size_t i = first; i < end; ++i)
+            {
+                const Half& h = halves[i];
+                std::snprintf(buf, sizeof buf, "C%.5g %.5g %.5g %.5g %.5g %.5g",
+                        h.p[1].x, h.p[1].y, h.p[2].x, h.p[2].y, h.p[3].x, h.p[3].y);
+                d += buf;
+            }
+
+            std::snprintf(buf, sizeof buf, "\" stroke-width=\"%.5g\" stroke=\"", SegmentMesh::HalfWidth * 2);
+            out += "<path d=\"" + d + buf;
+            AppendColour(out, run.start);
+            std::snprintf(buf, sizeof buf, "\" stroke-width=\"%.5g\" stroke=\"", SegmentMesh::HalfWidth);
+            out += "\"/>\n<path d=\"" + d + buf;
+            AppendColour(out, run.end);
+            out += "\"/>\n";
+        }
+
+        void AppendU32(std::string& out, unsigned int v)
+        {
+            for (int i = 0; i < 4; ++i)
+                out += char((v >> (i * 8)) & 0xff);
+        }
+
+        unsigned int ReadU32(const unsigned char* p)
+        {
+            return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+        }
+
+        double ReadDouble(const unsigned char* p)
+        {
+            unsigned long long bits = 0;
+            for (int i = 7; i >= 0; --i)
+                bits = (bits << 8) | p[i];
+
+            double v;
+            std::memcpy(&v, &bits, sizeof v);
+            return v;
+        }
+
+        void AppendDouble(std::string& out, double v)
+        {
+            unsigned long long bits;
+            std::memcpy(&bits, &v, sizeof bits);
+            for (int i = 0; i < 8; ++i)
+                out += char((bits >> (i * 8)) & 0xff);
+        }
+    }
+
+
+    void EncodeSVG(const Art& art, Random& random, double aspect, const float clear[3], int width, int height, std::string& out)
+    {
+        //Only the colours and crossings are needed, which placing instances gives without meshing anything.
+        SegmentMesh mesh;
+        Instance(art, random, mesh);
+
+        char buf[256];
+        std::snprintf(buf, sizeof buf,
+                "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" viewBox=\"0 0 %.5g 1\">\n"
+                "<rect width=\"%.5g\" height=\"1\" fill=\"", width, height, aspect, aspect);
+        out = buf;
+        AppendColour(out, clear);
+        out += "\"/>\n<g fill=\"none\" stroke-linecap=\"butt\" stroke-linejoin=\"round\">\n";
+
+        std::vector<Half> halves;
+        std::vector<bool> over;
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (size_t i = 0; i < art.GetThreadCount(); ++i)
+            {
+                const Art::Thread& thread = *art.GetThread(i);
+                const SegmentMesh::Thread& run = mesh.threads[i];
+
+                halves.resize(run.count * 2);
+                over.resize(run.count * 2);
+                for (size_t j = 0; j < run.count; ++j)
+                {
+                    Split(thread, j, &halves[j * 2]);
+                    over[j * 2] = mesh.instances[run.first + j].over[0];
+                    over[j * 2 + 1] = mesh.instances[run.first + j].over[1];
+                }
+
+                //Neighbouring halves on the same side of the crossings join into one path.
+                for (size_t h = 0; h < halves.size();)
+                {
+                    size_t end = h + 1;
+                    while (end < halves.size() && over[end] == over[h])
+                        ++end;
+                    if (over[h] == (pass == 1))
+                        AppendRun(out, &halves.front(), h, end, run);
+                    h = end;
+                }
+            }
+        }
+
+        out += "</g>\n</svg>\n";
+    }
+
+
+    void EncodeArt(const Art& art, std::string& out)
+    {
+        out = "CKNA";
+        AppendU32(out, 1);
+        AppendU32(out, (unsigned int)art.GetThreadCount());
+
+        for (size_t i = 0; i < art.GetThreadCount(); ++i)
+        {
+            const Art::Thread& thread = *art.GetThread(i);
+            const Art::Z& z = *art.GetZ(i);
+
+            AppendU32(out, (unsigned int)thread.GetKnotCount());
+            for (size_t j = 0; j < thread.GetKnotCount(); ++j)
+            {
+                const vec2 y = thread.GetKnotY(j), m = thread.GetKnotM(j);
+                AppendDouble(out, thread.GetKnotX(j));
+                AppendDouble(out, y.x);
+                AppendDouble(out, y.y);
+                AppendDouble(out, m.x);
+                AppendDouble(out, m.y);
+                AppendDouble(out, z.GetKnotY(j));
+            }
+        }
+    }
+
+
+    AutoArt DecodeArt(const char* data, size_t size)
+    {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        const unsigned char* end = p + size;
+
+        if (size < 12 || std::memcmp(p, "CKNA", 4) || ReadU32(p + 4) != 1)
+            return AutoArt();
+
+        const size_t threads = ReadU32(p + 8);
+        p += 12;
+
+        Art::SplineVector sv;
+        Art::ZVector zv;
+        std::vector<double> xs, zs;
+        std::vector<vec2> ys, ms;
+
+        for (size_t i = 0; i < threads; ++i)
+        {
+            const size_t knots = end - p >= 4 ? ReadU32(p) : 0;
+            p += 4;
+            if (knots < 2 || size_t(end - p) / 48 < knots)
+                break;
+
+            xs.resize(knots);
+            zs.resize(knots);
+            ys.resize(knots);
+            ms.resize(knots);
+            for (size_t j = 0; j < knots; ++j, p += 48)
+            {
+                xs[j] = ReadDouble(p);
+                ys[j] = vec2(ReadDouble(p + 8), ReadDouble(p + 16));
+                ms[j] = vec2(ReadDouble(p + 24), ReadDouble(p + 32));
+                zs[j] = ReadDouble(p + 40);
+            }
+
+            sv.push_back(new Art::Thread(&xs.front(), &ys.front(), &ms.front(), knots, true));
+            zv.push_back(new Art::Z(&xs.front(), &zs.front(), knots, true));
+        }
+
+        //Art owns the splines, so it frees them even if we give up on it.
+        AutoArt art(new Art(sv, zv));
+        if (sv.size() != threads || p != end)
+            return AutoArt();
+        return art;
+    }
+
+
+    void EncodeKnot(const Art& art, const Random& random, std::string& out)
+    {
+        std::string bytes;
+        EncodeArt(art, bytes);
+
+        out.clear();
+        AppendU32(out, random.GetState());
+        out += bytes;
+    }
+
+
+    AutoArt DecodeKnot(const char* data, size_t size, Random& random)
+    {
+        if (size < 4)
+            return AutoArt();
+
+        AutoArt art = DecodeArt(data + 4, size - 4);
+        if (art.get())
+            random.SetState(ReadU32(reinterpret_cast<const unsigned char*>(data)));
+        return art;
+    }
+
+}
@@ -0,0 +1,52 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __EXPORT_HPP__
+#define __EXPORT_HPP__
+
+#include <cstddef>
+#include <string>
+#include "cknot.hpp"
+#include "lattice.hpp"
+
+namespace CKnot
+{
+
+    ///Writes art as an SVG drawing, width by height pixels, showing the art's aspect by 1 units.
+    /**Each thread is a run of cubic Bezier paths, a dark full width stroke under a lighter narrower one. Halves
+     * of segments that cross under are drawn before those that cross over, so crossings read as they do on
+     * screen. Colours are drawn from random the way Tessellate draws them, so they match the raster image.
+     */
+    void EncodeSVG(const Art& art, Random& random, double aspect, const float clear[3], int width, int height, std::string& out);
+
+    ///Writes art's splines in a compact binary form.
+    /**The bytes "CKNA", then a 32 bit version, 1, and thread count. Each thread follows as its knot count, then
+     * for each knot six doubles: the spline parameter, x, y, tangent x, tangent y and the z step's value, where
+     * above 0 crosses over. Integers and doubles are little endian.
+     */
+    void EncodeArt(const Art& art, std::string& out);
+    AutoArt DecodeArt(const char* data, size_t size); ///<Reads what EncodeArt wrote. Returns null if it isn't that.
+
+    ///Writes art and the state random was left in after making it, so a knot read back gets the same colours.
+    /**The state comes first, as a little endian 32 bit integer, then art as EncodeArt writes it.
+     */
+    void EncodeKnot(const Art& art, const Random& random, std::string& out);
+    AutoArt DecodeKnot(const char* data, size_t size, Random& random); ///<Reads what EncodeKnot wrote, setting random's state. Returns null if it isn't that.
+
+}
+
+#endif /*__EXPORT_HPP__*/
@@ -0,0 +1,157 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <gl/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include "glrender.hpp"
+
+namespace CKnot
+{
+
+    namespace
+    {
+        const int FlowTexels = 256;
+    }
+
+
+    void GLRenderer::Begin(int width, int height, const float clear[3],
+            double left, double right, double bottom, double top)
+    {
+        //Set everything up each frame, the context may be shared with other engines.
+        mWidth = width;
+        mHeight = height;
+        glViewport(0, 0, width, height);
+
+        glMatrixMode(GL_PROJECTION);
+        glLoadIdentity();
+        glOrtho(left, right, bottom, top, -1.0, 1.0);
+
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+        glClearDepth(1.0f);
+
+        glPolygonMode(GL_FRONT_AND_BACK, mWire ? GL_LINE : GL_FILL);
+
+        glClearColor(clear[0], clear[1], clear[2], 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+
+        mFlow = Flow();
+    }
+
+
+    void GLRenderer::SetFlow(const Flow& flow)
+    {
+        mFlow = flow;
+        if (flow.depth <= 0.0f)
+            return;
+
+        if (!mTexture)
+            glGenTextures(1, &mTexture);
+        glBindTexture(GL_TEXTURE_1D, mTexture);
+
+        if (mTextureFlow.band != flow.band || mTextureFlow.depth != flow.depth)
+        {
+            unsigned char texels[FlowTexels];
+            for (int i = 0; i < FlowTexels; ++i)
+                texels[i] = (unsigned char)(flow.GetShade((i + 0.5) / FlowTexels) * 255.0f + 0.5f);
+
+            glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage1D(GL_TEXTURE_1D, 0, GL_LUMINANCE, FlowTexels, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, texels);
+            mTextureFlow = flow;
+        }
+
+        //Along coordinates go in as they are. The matrix turns them into periods since the bands' offset.
+        glMatrixMode(GL_TEXTURE);
+        glLoadIdentity();
+        glScalef(1.0f / flow.period, 1.0f, 1.0f);
+        glTranslatef(-flow.offset, 0.0f, 0.0f);
+        glMatrixMode(GL_MODELVIEW);
+
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    }
+
+
+    void GLRenderer::DrawQuadStrip(const float* vertices, const float* along, size_t first, size_t count)
+    {
+        const bool flow = along && mFlow.depth > 0.0f;
+        if (flow)
+        {
+            glEnable(GL_TEXTURE_1D);
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glTexCoordPointer(1, GL_FLOAT, 4, along);
+        }
+
+        glVertexPointer(3, GL_FLOAT, 24, vertices);
+        glColorPointer(3, GL_FLOAT, 24, vertices + 3);
+        glDrawArrays(GL_QUAD_STRIP, first, count);
+
+        if (flow)
+        {
+            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+            glDisable(GL_TEXTURE_1D);
+        }
+    }
+
+
+    void GLRenderer::DrawLines(const float* vertices, size_t count)
+    {
+        glVertexPointer(2, GL_FLOAT, 20, vertices);
+        glColorPointer(3, GL_FLOAT, 20, vertices + 2);
+        glDrawArrays(GL_LINES, 0, count);
+    }
+
+
+    void GLRenderer::DrawOverlay(const float* vertices, size_t count)
+    {
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glOrtho(0.0, mWidth, mHeight, 0.0, -1.0, 1.0);
+        glMatrixMode(GL_MODELVIEW);
+
+        glDisable(GL_DEPTH_TEST);
+        DrawLines(vertices, count);
+        glEnable(GL_DEPTH_TEST);
+
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+    }
+
+
+    void GLRenderer::End()
+    {
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisableClientState(GL_COLOR_ARRAY);
+    }
+
+}
@@ -0,0 +1,54 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GLRENDER_HPP__
+#define __GLRENDER_HPP__
+
+#include "render.hpp"
+
+namespace CKnot
+{
+
+    ///Draws with OpenGL 1.1 vertex arrays. A context must be current.
+    /**Flow bands are a 1D texture of one period, repeated along the strips by the texture matrix, so moving
+     * them only changes the matrix. The texture is only remade when the bands' shape changes.
+     */
+    class GLRenderer : public Renderer
+    {
+        public:
+            explicit GLRenderer(bool wire = false):mWire(wire), mWidth(0), mHeight(0), mTexture(0){}
+
+            virtual void Begin(int width, int height, const float clear[3],
+                    double left, double right, double bottom, double top);
+            virtual void SetFlow(const Flow& flow);
+            virtual void DrawQuadStrip(const float* vertices, const float* along, size_t first, size_t count);
+            virtual void DrawLines(const float* vertices, size_t count);
+            virtual void DrawOverlay(const float* vertices, size_t count);
+            virtual void End();
+
+        private:
+            bool mWire; ///<Draw polygon outlines only.
+            int mWidth, mHeight; ///<Size of the frame being drawn.
+
+            Flow mFlow;
+            unsigned int mTexture; ///<Bands of mTextureFlow, 0 until first needed.
+            Flow mTextureFlow;
+    };
+
+}
+
+#endif /*__GLRENDER_HPP__*/
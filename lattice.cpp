@@ -0,0 +1,146 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lattice.hpp"
+
+#include <map>
+
+namespace CKnot
+{
+
+    namespace
+    {
+        StrokeType RandomType(Random& random, const LatticeParams& params)
+        {
+            const double r = random.Unit();
+
+            if (r < params.bounce)
+                return Bounce;
+            else if (r < params.bounce + params.glance)
+                return Glance;
+            else
+                return Cross;
+        }
+    }
+
+
+    void Random::Seed(unsigned int seed)
+    {
+        //Spread the seed out, xorshift doesn't like small or zero states.
+        mState = (seed ^ 0x9e3779b9u) * 2654435761u;
+        if (!mState)
+            mState = 1;
+    }
+
+
+    int Random::Next()
+    {
+        mState ^= mState << 13;
+        mState ^= mState >> 17;
+        mState ^= mState << 5;
+        return int(mState >> 1);
+    }
+
+
+    StrokeList CreateSquareStrokes(Random& random, double width, double height, const LatticeParams& params)
+    {
+        StrokeList sl;
+
+        //Create a square grid.
+        const double junctionsPer = params.junctionsPer > 0.0 ? params.junctionsPer : 6 + (random.Next() % 9);
+
+        const size_t junctionsX = size_t(junctionsPer * width);
+        const size_t junctionsY = size_t(junctionsPer * height);
+
+        //cx and nx store the current and next x.
+        //They must not be recalculated each iteration, or the results sometimes don't
+        //match (even if they are calculated in EXACTLY the same way).
+        double cx = double(1) / junctionsX * width;
+
+        for (size_t x = 1; x < junctionsX; ++x)
+        {
+            double nx = double(x + 1) / junctionsX * width;
+
+            double cy = double(1) / junctionsY * height;
+
+            for (size_t y = 1; y < junctionsY; ++y)
+            {
+                double ny = double(y + 1) / junctionsY * height;
+
+                if (x + 1 != junctionsX)
+                    sl.push_back(Stroke(vec2(cx, cy), vec2(nx, cy), RandomType(random, params)));
+
+                if (y + 1 != junctionsY)
+                    sl.push_back(Stroke(vec2(cx, cy), vec2(cx, ny), RandomType(random, params)));
+
+                cy = ny;
+            }
+
+            cx = nx;
+        }
+
+        return sl;
+    }
+
+
+    StrokeList RemoveStrokes(Random& random, const StrokeList& in, const LatticeParams& params)
+    {
+        StrokeList sl = in;
+
+        //Delete some strokes at random.
+        const int delThres = params.removal > 0.0 ?
+            int(Random::Max * params.removal) :
+            Random::Max / (3 + (random.Next() % 20));
+        for (StrokeList::iterator it = sl.begin(); it != sl.end();)
+        {
+            if (random.Next() < delThres)
+                sl.erase(it++);
+            else
+                ++it;
+        }
+
+        //Now purge all strokes that aren't connected at both ends.
+        //This gets rid of loops that can make the graphics overlap.
+        std::map<vec2, size_t> sCount;
+        for (StrokeList::iterator it = sl.begin(); it != sl.end(); ++it)
+        {
+            //Count strokes at each junction.
+            if (sCount.count(it->a))
+                ++(sCount[it->a]);
+            else
+                sCount[it->a] = 1;
+
+            if (sCount.count(it->b))
+                ++(sCount[it->b]);
+            else
+                sCount[it->b] = 1;
+        }
+        for (StrokeList::iterator it = sl.begin(); it != sl.end();)
+        {
+            //Remove strokes that have open junctions.
+            //Removing these can make more open junctions,
+            //but these new loops will have some room to not hit other curves.
+            if (sCount[it->a] == 1 || sCount[it->b] == 1)
+                sl.erase(it++);
+            else
+                ++it;
+        }
+
+        return sl;
+    }
+
+}
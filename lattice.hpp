@@ -0,0 +1,63 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __LATTICE_HPP__
+#define __LATTICE_HPP__
+
+#include "cknot.hpp"
+
+namespace CKnot
+{
+
+    ///Small random number generator. Each engine owns one, so engines don't share rand()'s state.
+    class Random
+    {
+        public:
+            static const int Max = 0x7fffffff;
+
+            explicit Random(unsigned int seed = 1) {Seed(seed);}
+
+            void Seed(unsigned int seed);
+            int Next(); ///<Returns a number from 0 to Max.
+            double Unit() {return double(Next()) / Max;} ///<Returns a number from 0 to 1.
+
+            unsigned int GetState() const {return mState;} ///<Returns where the sequence is, to pick it up again later with SetState.
+            void SetState(unsigned int state) {mState = state ? state : 1;}
+
+        private:
+            unsigned int mState;
+    };
+
+
+    ///Controls the random lattice knots are built on.
+    struct LatticeParams
+    {
+        double junctionsPer; ///<Junctions per unit, 0 for a random density from 6 to 14.
+        double bounce; ///<Chance of each stroke being a bounce.
+        double glance; ///<Chance of each stroke being a glance.
+        double removal; ///<Fraction of strokes deleted, 0 for a random fraction from 1/22 to 1/3.
+
+        LatticeParams():junctionsPer(0.0), bounce(1.0 / 15.0), glance(1.0 / 15.0), removal(0.0){}
+    };
+
+
+    StrokeList CreateSquareStrokes(Random& random, double width, double height, const LatticeParams& params = LatticeParams()); ///<Creates a random square lattice of strokes covering width by height.
+    StrokeList RemoveStrokes(Random& random, const StrokeList& in, const LatticeParams& params = LatticeParams()); ///<Deletes random strokes, then strokes left hanging at one end.
+
+}
+
+#endif /*__LATTICE_HPP__*/
@@ -0,0 +1,718 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include "ribbon.hpp"
+
+namespace CKnot
+{
+
+    namespace
+    {
+        const double Quantum = 1e-6; ///<Segments closer than this in shape share a template.
+        const size_t ChunkSegments = 256; ///<Segments per pool job. Small enough to balance, big enough to not notice the pool.
+
+        ///A segment's shape in its own frame: its length and the tangents at each end.
+        struct Key
+        {
+            long long v[5];
+
+            bool operator<(const Key& rhs) const
+            {
+                for (int i = 0; i < 5; ++i)
+                    if (v[i] != rhs.v[i])
+                        return v[i] < rhs.v[i];
+                return false;
+            }
+        };
+
+        ///A segment in its own frame, with its first node at the origin and the next on the +x axis.
+        struct Frame
+        {
+            vec2 origin;
+            vec2 axis; ///<Unit vector along the frame's x axis.
+            double length;
+            vec2 m0, m1; ///<Tangents in the frame.
+
+            Frame(const Art::Thread& thread, size_t segment)
+            {
+                origin = thread.GetKnotY(segment);
+
+                const vec2 d = thread.GetKnotY(segment + 1) - origin;
+                length = d.GetLength();
+                axis = length > 0.0 ? d * (1.0 / length) : vec2(1.0, 0.0);
+
+                const vec2 gm0 = thread.GetKnotM(segment);
+                const vec2 gm1 = thread.GetKnotM(segment + 1);
+                m0 = vec2(gm0.x * axis.x + gm0.y * axis.y, gm0.y * axis.x - gm0.x * axis.y);
+                m1 = vec2(gm1.x * axis.x + gm1.y * axis.y, gm1.y * axis.x - gm1.x * axis.y);
+            }
+
+            Key GetKey() const
+            {
+                Key key;
+                key.v[0] = Quantize(length);
+                key.v[1] = Quantize(m0.x);
+                key.v[2] = Quantize(m0.y);
+                key.v[3] = Quantize(m1.x);
+                key.v[4] = Quantize(m1.y);
+                return key;
+            }
+
+            static long long Quantize(double d)
+            {
+                return (long long)std::floor(d / Quantum + 0.5);
+            }
+        };
+
+        ///Meshes a segment in its own frame.
+        void BuildTemplate(const Frame& frame, SegmentMesh::Template& out)
+        {
+            const vec2 y0(0.0, 0.0);
+            const vec2 y1(frame.length, 0.0);
+
+            const int n = SegmentMesh::Samples + 1;
+            float px[n], py[n], tx[n], ty[n];
+
+            for (int i = 0; i < n; ++i)
+            {
+                const double t = double(i) / SegmentMesh::Samples;
+
+                const vec2 cur = Spline::Function::Hermite<vec2, double>(frame.m0, y0, y1, frame.m1, t);
+                const vec2 diff = Spline::Derivatives::Hermite<vec2, double>(frame.m0, y0, y1, frame.m1, t);
+
+                px[i] = cur.x;
+                py[i] = cur.y;
+                tx[i] = diff.x;
+                ty[i] = diff.y;
+            }
+
+            out.resize(n * 4);
+            Ribbon::Extrude(px, py, tx, ty, n, SegmentMesh::HalfWidth, &out.front());
+        }
+
+        ///A run of segments along one thread.
+        struct Chunk
+        {
+            size_t thread;
+            size_t first, count; ///<Segments along the thread.
+        };
+
+        ///Cuts threads into chunks of up to ChunkSegments, so one long thread spreads over the whole pool.
+        void MakeChunks(const std::vector<SegmentMesh::Thread>& threads, size_t firstThread, std::vector<Chunk>& chunks)
+        {
+            for (size_t i = firstThread; i < threads.size(); ++i)
+            {
+                for (size_t j = 0; j < threads[i].count; j += ChunkSegments)
+                {
+                    Chunk c;
+                    c.thread = i;
+                    c.first = j;
+                    c.count = std::min(ChunkSegments, threads[i].count - j);
+                    chunks.push_back(c);
+                }
+            }
+        }
+
+        struct PlaceJob
+        {
+            const Art* art;
+            SegmentMesh* mesh;
+            size_t firstThread; ///<Where the art's threads start in mesh.threads.
+            size_t firstInstance; ///<Where its instances start in mesh.instances.
+            std::vector<Chunk> chunks;
+            std::vector<Key, BufferAllocator<Key> > keys; ///<Shape of each of the art's instances.
+        };
+
+        ///Places the instances of a chunk and finds their shape keys. Shapes are looked up afterwards, on one thread.
+        void PlaceChunk(void* context, size_t index)
+        {
+            CKNOT_TRACE_SCOPE("place chunk");
+
+            PlaceJob& job = *static_cast<PlaceJob*>(context);
+            const Chunk& chunk = job.chunks[index];
+            const SegmentMesh::Thread& run = job.mesh->threads[chunk.thread];
+
+            const Art::Thread& thread = *job.art->GetThread(chunk.thread - job.firstThread);
+            const Art::Z& z = *job.art->GetZ(chunk.thread - job.firstThread);
+
+            for (size_t j = chunk.first; j < chunk.first + chunk.count; ++j)
+            {
+                const Frame frame(thread, j);
+                job.keys[run.first + j - job.firstInstance] = frame.GetKey();
+
+                //The z spline steps halfway along each segment.
+                SegmentMesh::Instance& inst = job.mesh->instances[run.first + j];
+                inst.shape = 0;
+                inst.x = frame.origin.x;
+                inst.y = frame.origin.y;
+                inst.c = frame.axis.x;
+                inst.s = frame.axis.y;
+                inst.over[0] = z.GetKnotY(j) > 0.0;
+                inst.over[1] = z.GetKnotY(j + 1) > 0.0;
+
+                job.mesh->bounds[run.first + j] = GetSegmentBounds(thread, j, SegmentMesh::HalfWidth);
+            }
+        }
+
+        struct ExpandJob
+        {
+            const SegmentMesh* mesh;
+            const Arrays* arrays; ///<A quad strip for each thread of the mesh, already sized.
+            std::vector<Chunk> chunks;
+        };
+
+        ///Writes out the vertices of segments first to first + count of a thread, at their place in its strip.
+        void ExpandSegments(const SegmentMesh& mesh, size_t thread, size_t first, size_t count, float* strip)
+        {
+            const SegmentMesh::Thread& run = mesh.threads[thread];
+
+            const int Half = (SegmentMesh::Samples + 1) / 2; //First sample of the second half, where t >= .5.
+
+            //Each segment gives its samples but the last, which the next one starts on. The final segment gives all of them.
+            float* out = strip + first * SegmentMesh::Samples * 12;
+
+            Ribbon::Placement p;
+            p.start = run.start;
+            p.end = run.end;
+
+            for (size_t j = first; j < first + count; ++j)
+            {
+                const SegmentMesh::Instance& inst = mesh.instances[run.first + j];
+                const float* edges = &mesh.templates[inst.shape].front();
+                const int samples = j + 1 == run.count ? SegmentMesh::Samples + 1 : SegmentMesh::Samples;
+
+                p.x = inst.x;
+                p.y = inst.y;
+                p.c = inst.c;
+                p.s = inst.s;
+
+                p.z = inst.over[0] ? 0.01f : .1f;
+                Ribbon::Place(edges, Half, p, out);
+
+                p.z = inst.over[1] ? 0.01f : .1f;
+                Ribbon::Place(edges + Half * 4, samples - Half, p, out + Half * 12);
+
+                out += samples * 12;
+            }
+        }
+
+        ///Writes out the vertices of a chunk, at the chunk's own place in its thread's strip.
+        void ExpandChunk(void* context, size_t index)
+        {
+            CKNOT_TRACE_SCOPE("expand chunk");
+
+            const ExpandJob& job = *static_cast<ExpandJob*>(context);
+            const Chunk& chunk = job.chunks[index];
+            ExpandSegments(*job.mesh, chunk.thread, chunk.first, chunk.count, &(*job.arrays)[chunk.thread]->front());
+        }
+    }
+
+
+    const double SegmentMesh::HalfWidth = .01;
+
+
+    Box GetSegmentBounds(const Art::Thread& thread, size_t segment, double pad)
+    {
+        //The Hermite segment is a Bezier curve with control points a third of each tangent in from its ends.
+        const vec2 p0 = thread.GetKnotY(segment);
+        const vec2 p1 = thread.GetKnotY(segment + 1);
+        const vec2 c0 = p0 + thread.GetKnotM(segment) * (1.0 / 3.0);
+        const vec2 c1 = p1 - thread.GetKnotM(segment + 1) * (1.0 / 3.0);
+
+        Box b;
+        b.min[0] = float(std::min(std::min(p0.x, p1.x), std::min(c0.x, c1.x)) - pad);
+        b.min[1] = float(std::min(std::min(p0.y, p1.y), std::min(c0.y, c1.y)) - pad);
+        b.max[0] = float(std::max(std::max(p0.x, p1.x), std::max(c0.x, c1.x)) + pad);
+        b.max[1] = float(std::max(std::max(p0.y, p1.y), std::max(c0.y, c1.y)) + pad);
+        return b;
+    }
+
+
+    size_t SegmentMesh::GetBytes() const
+    {
+        size_t ret = instances.capacity() * sizeof(Instance) + threads.capacity() * sizeof(Thread);
+        for (size_t i = 0; i < templates.size(); ++i)
+            ret += templates[i].capacity() * sizeof(float);
+        return ret;
+    }
+
+
+    void Instance(const Art& art, Random& random, SegmentMesh& mesh, Stats* stats, Pool* pool)
+    {
+        PlaceJob job;
+        job.art = &art;
+        job.mesh = &mesh;
+        job.firstThread = mesh.threads.size();
+        job.firstInstance = mesh.instances.size();
+
+        //Lay out every thread's instances first, so chunks can fill them in any order.
+        const size_t threadCount = art.GetThreadCount();
+        mesh.threads.reserve(mesh.threads.size() + threadCount);
+
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            SegmentMesh::Thread run;
+            run.first = job.firstInstance + job.keys.size();
+            run.count = art.GetThread(i)->GetKnotCount() - 1; //The last knot is the first again.
+
+            run.start[0] = random.Unit() / 2;
+            run.end[0] = random.Unit() / 2 + .5;
+            run.start[1] = random.Unit() / 2;
+            run.end[1] = random.Unit() / 2 + .5;
+            run.start[2] = random.Unit() / 2;
+            run.end[2] = random.Unit() / 2 + .5;
+
+            mesh.threads.push_back(run);
+            job.keys.resize(job.keys.size() + run.count);
+        }
+
+        mesh.instances.resize(job.firstInstance + job.keys.size());
+        mesh.bounds.resize(mesh.instances.size());
+
+        MakeChunks(mesh.threads, job.firstThread, job.chunks);
+        ParallelFor(pool, job.chunks.size(), PlaceChunk, &job);
+
+        //Neighbouring segments often share a shape, so check the last one before the map.
+        std::map<Key, unsigned int> shapes;
+        std::map<Key, unsigned int>::const_iterator last = shapes.end();
+
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            const SegmentMesh::Thread& run = mesh.threads[job.firstThread + i];
+
+            for (size_t j = 0; j < run.count; ++j)
+            {
+                const Key& key = job.keys[run.first + j - job.firstInstance];
+
+                if (last == shapes.end() || key < last->first || last->first < key)
+                {
+                    last = shapes.find(key);
+                    if (last == shapes.end())
+                    {
+                        last = shapes.insert(std::make_pair(key, (unsigned int)mesh.templates.size())).first;
+                        mesh.templates.push_back(SegmentMesh::Template());
+                        BuildTemplate(Frame(*art.GetThread(i), j), mesh.templates.back());
+                    }
+                }
+
+                mesh.instances[run.first + j].shape = last->second;
+            }
+        }
+
+        CKNOT_COUNT(stats, CountTemplates, mesh.templates.size());
+        CKNOT_COUNT(stats, CountInstances, mesh.instances.size());
+    }
+
+
+    void Expand(const SegmentMesh& mesh, Arrays& arrays, Stats* stats, Pool* pool)
+    {
+        ExpandJob job;
+        job.mesh = &mesh;
+
+        //Size every strip up front, so each chunk knows where its vertices go.
+        const size_t firstThread = arrays.size();
+        for (size_t i = 0; i < mesh.threads.size(); ++i)
+        {
+            const size_t vertices = 2 * (mesh.threads[i].count * SegmentMesh::Samples + 1);
+            arrays.push_back(new FloatArray(vertices * 6));
+
+            CKNOT_COUNT(stats, CountVertices, vertices);
+        }
+
+        //Chunks index threads of the mesh, which start at firstThread in arrays.
+        Arrays strips(arrays.begin() + firstThread, arrays.end());
+        job.arrays = &strips;
+
+        MakeChunks(mesh.threads, 0, job.chunks);
+        ParallelFor(pool, job.chunks.size(), ExpandChunk, &job);
+    }
+
+
+    void Tessellate(const Art& art, Random& random, Arrays& arrays, Stats* stats, Pool* pool)
+    {
+        CKNOT_PHASE(stats, PhaseMesh);
+
+        SegmentMesh mesh;
+        Instance(art, random, mesh, stats, pool);
+        Expand(mesh, arrays, stats, pool);
+    }
+
+
+    void FreeArrays(Arrays& arrays)
+    {
+        for (size_t i = 0; i < arrays.size(); ++i)
+            delete arrays[i];
+        arrays.clear();
+    }
+
+
+    namespace
+    {
+        const size_t SampleFloats = 12; ///<Two vertices of six floats.
+        const double MinMorph = 1.0 / 64; ///<Morphs less than this draw the finer level as it is.
+        const size_t BlockSamples = KnotMesh::BlockSegments * SegmentMesh::Samples; ///<Level 0 samples in each block.
+    }
+
+
+    void KnotMesh::Build(const Art& art, Random& random, Stats* stats, Pool* pool)
+    {
+        CKNOT_PHASE(stats, PhaseMesh);
+
+        Clear();
+        Instance(art, random, mMesh, stats, pool);
+
+        //Rotating a template keeps its length, so each shape's centre line is measured once.
+        const size_t n = SegmentMesh::Samples + 1;
+        mShapeAlong.resize(mMesh.templates.size() * n);
+        for (size_t i = 0; i < mMesh.templates.size(); ++i)
+        {
+            const float* edges = &mMesh.templates[i].front();
+            float* along = &mShapeAlong[i * n];
+
+            along[0] = 0.0f;
+            for (size_t k = 1; k < n; ++k)
+            {
+                const float* a = edges + (k - 1) * 4;
+                const float* b = edges + k * 4;
+                const double dx = (b[0] + b[2] - a[0] - a[2]) * 0.5, dy = (b[1] + b[3] - a[1] - a[3]) * 0.5;
+                along[k] = float(along[k - 1] + std::sqrt(dx * dx + dy * dy));
+            }
+        }
+
+        mSegmentAlong.resize(mMesh.instances.size());
+        for (size_t i = 0; i < mMesh.threads.size(); ++i)
+        {
+            const SegmentMesh::Thread& run = mMesh.threads[i];
+            double along = 0.0;
+            for (size_t j = run.first; j < run.first + run.count; ++j)
+            {
+                mSegmentAlong[j] = float(along);
+                along += mShapeAlong[mMesh.instances[j].shape * n + SegmentMesh::Samples];
+            }
+        }
+
+        size_t blockCount = 0;
+        mThreads.resize(mMesh.threads.size());
+        for (size_t i = 0; i < mThreads.size(); ++i)
+        {
+            const SegmentMesh::Thread& run = mMesh.threads[i];
+            const Art::Thread& thread = *art.GetThread(i);
+            Thread& t = mThreads[i];
+
+            t.samples = run.count * SegmentMesh::Samples + 1;
+            for (int l = 0; l < Levels; ++l)
+            {
+                t.strips[l] = new FloatArray(GetSampleCount(i, l) * SampleFloats);
+                t.along[l] = new FloatArray(GetSampleCount(i, l) * 2);
+            }
+
+            const size_t blocks = (run.count + BlockSegments - 1) / BlockSegments;
+            t.blocks.assign(blocks, Box::Empty());
+            t.filled.assign(blocks, 0);
+            blockCount += blocks;
+
+            double length = 0.0;
+            for (size_t j = 0; j < run.count; ++j)
+            {
+                t.blocks[j / BlockSegments].Add(mMesh.bounds[run.first + j]);
+                length += (thread.GetKnotY(j + 1) - thread.GetKnotY(j)).GetLength();
+            }
+
+            t.bounds = Box::Empty();
+            for (size_t b = 0; b < blocks; ++b)
+                t.bounds.Add(t.blocks[b]);
+
+            t.spacing = t.samples > 1 ? length / (t.samples - 1) : 0.0;
+
+            CKNOT_COUNT(stats, CountVertices, t.samples * 2);
+        }
+
+        //Drawing in reaches new blocks and morphs longer spans for a while, so make room now rather than mid animation.
+        mSpans.reserve(blockCount);
+        mTasks.reserve(blockCount);
+        //Any level but the last may be morphed, so the longest span is a whole level 0 strip.
+        for (size_t i = 0; i < mThreads.size(); ++i)
+            mMorph.reserve(mThreads[i].strips[0]->size());
+    }
+
+
+    void KnotMesh::MeshAll(Pool* pool)
+    {
+        for (size_t i = 0; i < mThreads.size(); ++i)
+        {
+            for (size_t b = 0; b < mThreads[i].blocks.size(); ++b)
+            {
+                if (mThreads[i].filled[b] & 1)
+                    continue;
+
+                mThreads[i].filled[b] |= 1;
+                const Task task = {i, b, 0};
+                mTasks.push_back(task);
+            }
+        }
+
+        Fill(pool);
+    }
+
+
+    void KnotMesh::Clear()
+    {
+        for (size_t i = 0; i < mThreads.size(); ++i)
+        {
+            for (int l = 0; l < Levels; ++l)
+            {
+                delete mThreads[i].strips[l];
+                delete mThreads[i].along[l];
+            }
+        }
+        mThreads.clear();
+
+        //Keeps the vectors' buffers for the next knot.
+        mMesh.templates.clear();
+        mMesh.instances.clear();
+        mMesh.bounds.clear();
+        mMesh.threads.clear();
+        mShapeAlong.clear();
+        mSegmentAlong.clear();
+    }
+
+
+    size_t KnotMesh::GetSampleCount(size_t thread, int level) const
+    {
+        const size_t last = mThreads[thread].samples - 1;
+        return (last >> level) + 1 + ((last & ((size_t(1) << level) - 1)) != 0);
+    }
+
+
+    double KnotMesh::GetLevel(size_t thread, double pixelsPerUnit, double pixelsPerSample) const
+    {
+        const double spacing = mThreads[thread].spacing * pixelsPerUnit;
+        if (spacing <= 0.0 || pixelsPerSample <= 0.0)
+            return 0.0;
+
+        const double level = std::log(pixelsPerSample / spacing) / std::log(2.0);
+        return std::min(std::max(level, 0.0), double(Levels - 1));
+    }
+
+
+    void KnotMesh::Cull(size_t thread, double level, const Box& view, size_t first, size_t count)
+    {
+        const Thread& t = mThreads[thread];
+        const int l = int(level);
+        const size_t n = GetSampleCount(thread, l);
+        const size_t end = first + count;
+
+        for (size_t b = 0; b < t.blocks.size(); ++b)
+        {
+            if (!view.Overlaps(t.blocks[b]))
+                continue;
+
+            //The block's samples, and the next block's first so neighbouring blocks join up.
+            const size_t s0 = b * BlockSamples;
+            const size_t s1 = std::min((b + 1) * BlockSamples, t.samples - 1);
+            const size_t a = std::max(s0 >> l, first);
+            const size_t e = std::min(std::min(((s1 + (size_t(1) << l) - 1) >> l) + 1, n), end);
+            if (e < a + 2)
+                continue;
+
+            if (!mSpans.empty() && mSpans.back().thread == thread && mSpans.back().first + mSpans.back().count >= a)
+                mSpans.back().count = e - mSpans.back().first;
+            else
+            {
+                const Span span = {thread, level, a, e - a};
+                mSpans.push_back(span);
+            }
+        }
+    }
+
+
+    void KnotMesh::Fill(Pool* pool)
+    {
+        CKNOT_TRACE_SCOPE("fill blocks");
+
+        ParallelFor(pool, mTasks.size(), FillJob, this);
+        mTasks.clear();
+    }
+
+
+    void KnotMesh::FillJob(void* context, size_t index)
+    {
+        const KnotMesh& mesh = *static_cast<KnotMesh*>(context);
+        mesh.FillBlock(mesh.mTasks[index]);
+    }
+
+
+    void KnotMesh::FillBlock(const Task& task) const
+    {
+        const Thread& t = mThreads[task.thread];
+        const size_t segments = mMesh.threads[task.thread].count;
+        const size_t first = task.block * BlockSegments;
+
+        if (task.level == 0)
+        {
+            const size_t count = std::min(size_t(BlockSegments), segments - first);
+            ExpandSegments(mMesh, task.thread, first, count, &t.strips[0]->front());
+
+            //Both edges of a sample are as far along as its centre.
+            const size_t firstInstance = mMesh.threads[task.thread].first;
+            float* along = &t.along[0]->front() + first * SegmentMesh::Samples * 2;
+            for (size_t j = first; j < first + count; ++j)
+            {
+                const float start = mSegmentAlong[firstInstance + j];
+                const float* shape = &mShapeAlong[mMesh.instances[firstInstance + j].shape * (SegmentMesh::Samples + 1)];
+                const int samples = j + 1 == segments ? SegmentMesh::Samples + 1 : SegmentMesh::Samples;
+
+                for (int k = 0; k < samples; ++k)
+                {
+                    *along++ = start + shape[k];
+                    *along++ = start + shape[k];
+                }
+            }
+            return;
+        }
+
+        //The block holds the samples at this level that come from its own level 0 samples.
+        const int l = task.level;
+        const bool lastBlock = task.block + 1 == t.blocks.size();
+        const size_t begin = task.block * BlockSamples;
+        const size_t end = lastBlock ? t.samples : (task.block + 1) * BlockSamples;
+
+        const float* in = &t.strips[0]->front();
+        float* out = &t.strips[l]->front();
+        const float* inAlong = &t.along[0]->front();
+        float* outAlong = &t.along[l]->front();
+
+        for (size_t i = (begin + (size_t(1) << l) - 1) >> l; (i << l) < end; ++i)
+        {
+            std::copy(in + (i << l) * SampleFloats, in + ((i << l) + 1) * SampleFloats, out + i * SampleFloats);
+            std::copy(inAlong + (i << l) * 2, inAlong + ((i << l) + 1) * 2, outAlong + i * 2);
+        }
+
+        //Every level keeps the last sample too.
+        const size_t last = t.samples - 1;
+        if (lastBlock && (last & ((size_t(1) << l) - 1)))
+        {
+            const size_t i = GetSampleCount(task.thread, l) - 1;
+            std::copy(in + last * SampleFloats, in + (last + 1) * SampleFloats, out + i * SampleFloats);
+            std::copy(inAlong + last * 2, inAlong + (last + 1) * 2, outAlong + i * 2);
+        }
+    }
+
+
+    const float* KnotMesh::GetVertices(const Span& span)
+    {
+        const int l = int(span.level);
+        const FloatArray& strip = *mThreads[span.thread].strips[l];
+        const float* ret = &strip.front() + span.first * SampleFloats;
+
+        const float morph = float(span.level - l);
+        if (morph < MinMorph || l == Levels - 1)
+            return ret;
+
+        //Odd samples are the ones the next level drops. Pull each towards where the next level would put it.
+        const size_t n = GetSampleCount(span.thread, l);
+        mMorph.resize(span.count * SampleFloats);
+        std::copy(ret, ret + span.count * SampleFloats, mMorph.begin());
+
+        for (size_t i = span.first | 1; i < span.first + span.count && i + 1 < n; i += 2)
+        {
+            const float* a = &strip[(i - 1) * SampleFloats];
+            const float* b = &strip[(i + 1) * SampleFloats];
+            float* v = &mMorph[(i - span.first) * SampleFloats];
+            for (size_t k = 0; k < SampleFloats; ++k)
+                v[k] += ((a[k] + b[k]) * 0.5f - v[k]) * morph;
+        }
+
+        return &mMorph.front();
+    }
+
+
+    RenderStats KnotMesh::Draw(Renderer& renderer, const Box& view, double pixelsPerUnit, double pixelsPerSample,
+            double progress, Pool* pool)
+    {
+        RenderStats stats;
+
+        mSpans.clear();
+        for (size_t i = 0; i < mThreads.size(); ++i)
+        {
+            if (!view.Overlaps(mThreads[i].bounds))
+            {
+                ++stats.culled;
+                continue;
+            }
+
+            const double level = GetLevel(i, pixelsPerUnit, pixelsPerSample);
+            const size_t n = GetSampleCount(i, int(level));
+
+            //Threads draw in from the middle out.
+            const size_t shown = size_t(std::min(std::max(progress, 0.0), 1.0) * n);
+            size_t start = n - shown;
+            start += start % 2;
+
+            Cull(i, level, view, start / 2, shown);
+            ++stats.threads;
+        }
+
+        //Mesh what is about to be drawn, then decimate it to the levels drawn at. Morphs read a sample either side.
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (size_t s = 0; s < mSpans.size(); ++s)
+            {
+                const Span& span = mSpans[s];
+                const int l = int(span.level);
+                const int fill = pass ? l : 0;
+                if (pass && !l)
+                    continue;
+
+                Thread& t = mThreads[span.thread];
+                const size_t a = span.first ? span.first - 1 : 0;
+                const size_t b = std::min(span.first + span.count, GetSampleCount(span.thread, l) - 1);
+                const size_t firstBlock = std::min(std::min(a << l, t.samples - 1) / BlockSamples, t.blocks.size() - 1);
+                const size_t lastBlock = std::min(std::min(b << l, t.samples - 1) / BlockSamples, t.blocks.size() - 1);
+
+                for (size_t block = firstBlock; block <= lastBlock; ++block)
+                {
+                    if (t.filled[block] & (1 << fill))
+                        continue;
+
+                    t.filled[block] |= 1 << fill;
+                    const Task task = {span.thread, block, fill};
+                    mTasks.push_back(task);
+                }
+            }
+
+            Fill(pool);
+        }
+
+        //Morphs move vertices by a fraction of a sample, so leave where they are along the thread be.
+        for (size_t s = 0; s < mSpans.size(); ++s)
+        {
+            const Span& span = mSpans[s];
+            renderer.DrawQuadStrip(GetVertices(span), &mThreads[span.thread].along[int(span.level)]->front() + span.first * 2, 0, span.count * 2);
+            stats.vertices += span.count * 2;
+            ++stats.drawCalls;
+        }
+
+        return stats;
+    }
+
+}
@@ -0,0 +1,217 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MESH_HPP__
+#define __MESH_HPP__
+
+#include <vector>
+#include "buffer.hpp"
+#include "cknot.hpp"
+#include "lattice.hpp"
+#include "pool.hpp"
+#include "render.hpp"
+
+namespace CKnot
+{
+
+    typedef std::vector<float, BufferAllocator<float> > FloatArray; ///<Big ones are recycled across knots, see Buffers.
+    typedef std::vector<FloatArray*> Arrays;
+
+
+    ///An axis aligned box in art space.
+    struct Box
+    {
+        float min[2], max[2];
+
+        bool Overlaps(const Box& rhs) const
+        {
+            return min[0] <= rhs.max[0] && rhs.min[0] <= max[0] && min[1] <= rhs.max[1] && rhs.min[1] <= max[1];
+        }
+
+        void Add(const Box& rhs)
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                if (rhs.min[i] < min[i])
+                    min[i] = rhs.min[i];
+                if (rhs.max[i] > max[i])
+                    max[i] = rhs.max[i];
+            }
+        }
+
+        static Box Empty()
+        {
+            const Box b = {{1e30f, 1e30f}, {-1e30f, -1e30f}};
+            return b;
+        }
+    };
+
+    ///Returns a box around segment of a thread, the curve between knots segment and segment + 1, grown by pad.
+    /**The segment stays inside the box of its Bezier control points, which is cheap and close.
+     */
+    Box GetSegmentBounds(const Art::Thread& thread, size_t segment, double pad = 0.0);
+
+
+    ///The ribbons of art as a few distinct segment shapes and where each one goes.
+    /**On a lattice, the thread between two nodes only takes a few shapes, which differ by where they are and
+     * which way they point. Each shape is meshed once, in a frame with the first node at the origin and the
+     * second on the +x axis. Every segment of every thread is then an instance: a shape, a rotation and an origin.
+     */
+    struct SegmentMesh
+    {
+        enum {Samples = 25}; ///<Ribbon samples along each segment.
+        static const double HalfWidth; ///<Half the width of a ribbon.
+
+        ///One distinct shape, as x, y of the left edge then x, y of the right edge at each of Samples + 1 samples.
+        typedef std::vector<float> Template;
+
+        struct Instance
+        {
+            unsigned int shape; ///<Index into templates.
+            float x, y; ///<Where the template's origin goes.
+            float c, s; ///<Cosine and sine of the template's rotation.
+            bool over[2]; ///<Whether the first and second halves of the segment cross over.
+        };
+
+        struct Thread
+        {
+            size_t first, count; ///<Range of instances, in order along the thread.
+            float start[3], end[3]; ///<Colours of the left and right edges.
+        };
+
+        std::vector<Template> templates;
+        std::vector<Instance, BufferAllocator<Instance> > instances;
+        std::vector<Box, BufferAllocator<Box> > bounds; ///<Around each instance's ribbon, from GetSegmentBounds.
+        std::vector<Thread> threads;
+
+        size_t GetBytes() const; ///<Returns roughly how much memory the mesh holds.
+    };
+
+    ///Finds the distinct segment shapes of art, meshes each of them once, and places an instance for every segment.
+    /**Each thread draws two random colours, in the same order Tessellate always has.
+     */
+    void Instance(const Art& art, Random& random, SegmentMesh& mesh, Stats* stats = 0, Pool* pool = 0);
+
+    ///Writes out the instances of mesh as one quad strip per thread, appended to arrays.
+    void Expand(const SegmentMesh& mesh, Arrays& arrays, Stats* stats = 0, Pool* pool = 0);
+
+    ///Turns each thread of art into a ribbon, one quad strip per thread.
+    /**Vertices are x, y, z, r, g, b. Each thread fades between two random colours across its width.
+     * New arrays are appended to arrays, free them with FreeArrays. The time taken is added to stats if given.
+     * Goes through a SegmentMesh, so each distinct segment shape is only evaluated once. Given a pool, threads
+     * are cut into fixed size chunks of segments that are placed and written out in parallel, each straight into
+     * its own part of the strip, so the work spreads evenly however long or short the threads are.
+     */
+    void Tessellate(const Art& art, Random& random, Arrays& arrays, Stats* stats = 0, Pool* pool = 0);
+    void FreeArrays(Arrays& arrays); ///<Deletes and clears each array.
+
+
+    ///A knot's ribbons, meshed a block of segments at a time as they come into view.
+    /**Building only places the segments, finds a box around each and sizes the strips. A block of segments
+     * is meshed the first time it is drawn, so a window onto a small part of a giant knot only pays for that
+     * part. Buffers that are never written never take memory, see Buffers.
+     * Each thread also has coarser levels of detail, for when it covers few pixels. Level l keeps every 2^l'th
+     * ribbon sample, and the last, so has about 1/2^l of the vertices. They are filled in a block at a time
+     * too. A thread's level comes from how far apart its samples land on screen, and may fall between two.
+     * Then the finer one is drawn with the samples the coarser one drops pulled towards the midpoint of their
+     * neighbours, so threads turn smoothly into the coarser level as they shrink, rather than popping.
+     * Every vertex also gets its distance along the thread's centre line, for the renderer's Flow. It comes from
+     * the length of each shape's template, so is worked out once per shape rather than per segment.
+     */
+    class KnotMesh
+    {
+        public:
+            enum
+            {
+                Levels = 6,
+                BlockSegments = 16 ///<Segments culled and meshed together.
+            };
+
+            KnotMesh(){}
+            ~KnotMesh() {Clear();}
+
+            ///Lays out art's ribbons, with the colours Tessellate would give them, but meshes nothing yet.
+            void Build(const Art& art, Random& random, Stats* stats = 0, Pool* pool = 0);
+            void MeshAll(Pool* pool = 0); ///<Meshes every block at full detail now, rather than when drawn.
+            void Clear();
+
+            size_t GetThreadCount() const {return mThreads.size();}
+            const Box& GetBounds(size_t thread) const {return mThreads[thread].bounds;}
+            size_t GetSampleCount(size_t thread, int level) const; ///<Returns how many ribbon samples a thread has at a level.
+
+            ///Returns the level that puts a thread's samples about pixelsPerSample apart, from 0 to Levels - 1.
+            double GetLevel(size_t thread, double pixelsPerUnit, double pixelsPerSample) const;
+
+            ///Draws the parts of each thread in view, meshing any that haven't been yet.
+            /**The view is in art units and covers pixelsPerUnit pixels per unit. Only the middle progress of each
+             * thread is drawn, from 0 for nothing to 1 for all of it. Levels of detail aim for pixelsPerSample
+             * between samples, 0 for full detail. Blocks are meshed on pool if given.
+             */
+            RenderStats Draw(Renderer& renderer, const Box& view, double pixelsPerUnit, double pixelsPerSample,
+                    double progress, Pool* pool = 0);
+
+        private:
+            KnotMesh(const KnotMesh&);
+            KnotMesh& operator=(const KnotMesh&);
+
+            ///A run of a thread's samples at one level.
+            struct Span
+            {
+                size_t thread;
+                double level;
+                size_t first, count;
+            };
+
+            struct Thread
+            {
+                Box bounds;
+                size_t samples; ///<Samples at level 0.
+                double spacing; ///<Average distance between samples at level 0.
+                FloatArray* strips[Levels]; ///<Quad strip at each level, meshed where filled says.
+                FloatArray* along[Levels]; ///<Distance along the thread of each vertex of the strips.
+                std::vector<Box> blocks;
+                std::vector<unsigned char> filled; ///<Bit l of each block is set once its samples at level l are.
+            };
+
+            ///A block to fill at a level.
+            struct Task
+            {
+                size_t thread, block;
+                int level;
+            };
+
+            void Cull(size_t thread, double level, const Box& view, size_t first, size_t count);
+            void Fill(Pool* pool);
+            void FillBlock(const Task& task) const;
+            const float* GetVertices(const Span& span);
+
+            static void FillJob(void* context, size_t index);
+
+            SegmentMesh mMesh;
+            std::vector<Thread> mThreads;
+            std::vector<float> mShapeAlong; ///<Distance along each template to each of its samples.
+            std::vector<float> mSegmentAlong; ///<Distance along its thread to the start of each instance.
+
+            //Kept between frames so drawing doesn't allocate.
+            std::vector<Span> mSpans;
+            std::vector<Task> mTasks;
+            FloatArray mMorph;
+    };
+
+}
+
+#endif /*__MESH_HPP__*/
@@ -0,0 +1,250 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "monitor.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace CKnot
+{
+
+    namespace
+    {
+        const int Scale = 2; ///<Screen pixels per font pixel.
+        const int Margin = 8;
+
+        struct Glyph
+        {
+            char c;
+            unsigned char rows[7]; ///<Top to bottom, bit 4 is the leftmost column.
+        };
+
+        ///A 5x7 font, just big enough for the overlay.
+        const Glyph Font[] = {
+            {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+            {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+            {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+            {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+            {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+            {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+            {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+            {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+            {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+            {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+            {'A', {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+            {'B', {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}},
+            {'C', {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}},
+            {'D', {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}},
+            {'E', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}},
+            {'F', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}},
+            {'G', {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}},
+            {'H', {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+            {'I', {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+            {'J', {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}},
+            {'K', {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}},
+            {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}},
+            {'M', {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}},
+            {'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+            {'O', {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+            {'P', {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}},
+            {'Q', {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}},
+            {'R', {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}},
+            {'S', {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}},
+            {'T', {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+            {'U', {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+            {'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}},
+            {'W', {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}},
+            {'X', {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}},
+            {'Y', {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}},
+            {'Z', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}},
+            {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}},
+            {':', {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}},
+            {'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+            {'-', {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}},
+            {'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+            {'(', {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}},
+            {')', {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}}};
+
+        ///Returns the glyph for a character, or null for a space or anything the font lacks.
+        const Glyph* GetGlyph(char c)
+        {
+            c = char(std::toupper((unsigned char)c));
+            for (size_t i = 0; i < sizeof(Font) / sizeof(*Font); ++i)
+                if (Font[i].c == c)
+                    return &Font[i];
+            return 0;
+        }
+
+        void AddPoint(std::vector<float>& lines, float x, float y, float shade)
+        {
+            lines.push_back(x);
+            lines.push_back(y);
+            lines.push_back(shade);
+            lines.push_back(shade);
+            lines.push_back(shade);
+        }
+
+        ///Adds text with its top left corner at x, y in pixels, as a horizontal line for each run of lit pixels.
+        void AddText(std::vector<float>& lines, const char* text, int x, int y, float shade)
+        {
+            for (; *text; ++text, x += 6 * Scale)
+            {
+                const Glyph* g = GetGlyph(*text);
+                if (!g)
+                    continue;
+
+                for (int row = 0; row < 7; ++row)
+                {
+                    for (int col = 0; col < 5; ++col)
+                    {
+                        if (!(g->rows[row] & (0x10 >> col)))
+                            continue;
+
+                        const int start = col;
+                        while (col + 1 < 5 && (g->rows[row] & (0x10 >> (col + 1))))
+                            ++col;
+
+                        for (int s = 0; s < Scale; ++s)
+                        {
+                            const float py = float(y + row * Scale + s) + 0.5f;
+                            AddPoint(lines, float(x + start * Scale), py, shade);
+                            AddPoint(lines, float(x + (col + 1) * Scale), py, shade);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+
+    Monitor::Summary::Summary()
+        :time(0), frames(0), interval(0), maxInterval(0), work(0), maxWork(0), memory(0)
+    {
+        last.interval = last.work = last.genTime = 0.0;
+        last.knot = 0;
+    }
+
+
+    Monitor::Monitor(double window)
+        :mWindow(window), mTime(0.0), mStartup(0.0)
+    {
+    }
+
+
+    bool Monitor::Add(const FrameSample& sample)
+    {
+        mTime += sample.interval;
+
+        ++mCurrent.frames;
+        mCurrent.interval += sample.interval;
+        mCurrent.maxInterval = std::max(mCurrent.maxInterval, sample.interval);
+        mCurrent.work += sample.work;
+        mCurrent.maxWork = std::max(mCurrent.maxWork, sample.work);
+        mCurrent.last = sample;
+
+        if (mCurrent.interval < mWindow)
+            return false;
+
+        mCurrent.time = mTime;
+        mCurrent.memory = GetResidentBytes();
+        mDone = mCurrent;
+        mCurrent = Summary();
+
+        BuildText();
+        return true;
+    }
+
+
+    std::string Monitor::ToJson() const
+    {
+        const Summary& s = mDone;
+        const double frames = s.frames ? double(s.frames) : 1.0;
+
+        char buf[576];
+        std::snprintf(buf, sizeof buf,
+                "{\"time\":%.3f,\"frames\":%lu,\"fps\":%.2f,\"frameMs\":{\"mean\":%.3f,\"max\":%.3f},"
+                "\"workMs\":{\"mean\":%.3f,\"max\":%.3f},\"knot\":%lu,\"genMs\":%.3f,"
+                "\"vertices\":%lu,\"threads\":%lu,\"culled\":%lu,\"drawCalls\":%lu,\"residentBytes\":%lu,\"startupMs\":%.3f}",
+                s.time, (unsigned long)s.frames, s.interval > 0.0 ? s.frames / s.interval : 0.0,
+                s.interval / frames * 1e3, s.maxInterval * 1e3, s.work / frames * 1e3, s.maxWork * 1e3,
+                (unsigned long)s.last.knot, s.last.genTime * 1e3, (unsigned long)s.last.render.vertices,
+                (unsigned long)s.last.render.threads, (unsigned long)s.last.render.culled,
+                (unsigned long)s.last.render.drawCalls, (unsigned long)s.memory, mStartup * 1e3);
+
+        return buf;
+    }
+
+
+    void Monitor::BuildText()
+    {
+        const Summary& s = mDone;
+        const double frames = s.frames ? double(s.frames) : 1.0;
+
+        char lines[5][64];
+        std::snprintf(lines[0], sizeof lines[0], "FPS %.1f  FRAME %.1f/%.1f MS",
+                s.interval > 0.0 ? s.frames / s.interval : 0.0, s.interval / frames * 1e3, s.maxInterval * 1e3);
+        std::snprintf(lines[1], sizeof lines[1], "WORK %.2f/%.2f MS", s.work / frames * 1e3, s.maxWork * 1e3);
+        std::snprintf(lines[2], sizeof lines[2], "KNOT %lu  GEN %.1f MS", (unsigned long)s.last.knot, s.last.genTime * 1e3);
+        std::snprintf(lines[3], sizeof lines[3], "VERTS %lu  THREADS %lu  DRAWS %lu", (unsigned long)s.last.render.vertices,
+                (unsigned long)s.last.render.threads, (unsigned long)s.last.render.drawCalls);
+        if (s.memory)
+            std::snprintf(lines[4], sizeof lines[4], "MEM %.1f MB", s.memory / (1024.0 * 1024.0));
+        else
+            std::snprintf(lines[4], sizeof lines[4], "MEM -");
+
+        mText.clear();
+        for (int i = 0; i < 5; ++i)
+        {
+            //A dark copy one pixel down and right keeps it readable on any background.
+            const int y = Margin + i * 9 * Scale;
+            AddText(mText, lines[i], Margin + 1, y + 1, 0.0f);
+            AddText(mText, lines[i], Margin, y, 1.0f);
+        }
+    }
+
+
+    void Monitor::Draw(Renderer& renderer) const
+    {
+        if (!mText.empty())
+            renderer.DrawOverlay(&mText.front(), mText.size() / 5);
+    }
+
+
+    size_t Monitor::GetResidentBytes()
+    {
+#ifdef __linux__
+        FILE* f = std::fopen("/proc/self/statm", "r");
+        if (!f)
+            return 0;
+
+        unsigned long size = 0, resident = 0;
+        const int n = std::fscanf(f, "%lu %lu", &size, &resident);
+        std::fclose(f);
+
+        return n == 2 ? size_t(resident) * size_t(sysconf(_SC_PAGESIZE)) : 0;
+#else
+        return 0;
+#endif
+    }
+
+}
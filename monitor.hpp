@@ -0,0 +1,84 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MONITOR_HPP__
+#define __MONITOR_HPP__
+
+#include <string>
+#include <vector>
+#include "render.hpp"
+
+namespace CKnot
+{
+
+    ///What one frame of the running animation cost.
+    struct FrameSample
+    {
+        double interval; ///<Seconds since the last frame.
+        double work; ///<Seconds spent updating and rendering this frame.
+        RenderStats render;
+        size_t knot; ///<Index of the knot on screen.
+        double genTime; ///<Seconds it took to make that knot.
+    };
+
+
+    ///Watches the running animation, for screensavers and kiosks out in the field.
+    /**Frames are summed up over windows of about a second. Each summary can be drawn over the frame
+     * as text, and written out as one line of JSON. Summing up is the only thing done every frame,
+     * the text and memory use are only updated when a window closes.
+     */
+    class Monitor
+    {
+        public:
+            explicit Monitor(double window = 1.0);
+
+            ///Adds a frame. Returns true if it closed a window, so there is a new summary.
+            bool Add(const FrameSample& sample);
+
+            void SetStartup(double seconds) {mStartup = seconds;} ///<Records how long the first frame took to show, from the program's start.
+
+            std::string ToJson() const; ///<Returns the last summary as a single line JSON object.
+            void Draw(Renderer& renderer) const; ///<Draws the last summary in the top left corner.
+
+            static size_t GetResidentBytes(); ///<Returns the memory the process has resident, or 0 if unknown.
+
+        private:
+            struct Summary
+            {
+                double time; ///<Seconds the monitor has watched, at the end of the window.
+                size_t frames;
+                double interval, maxInterval;
+                double work, maxWork;
+                FrameSample last;
+                size_t memory;
+
+                Summary();
+            };
+
+            void BuildText();
+
+            double mWindow;
+            double mTime;
+            double mStartup; ///<Seconds to the first frame, 0 if not known.
+            Summary mCurrent; ///<The window being added up.
+            Summary mDone; ///<The last closed window.
+            std::vector<float> mText; ///<Lines drawing the text of mDone.
+    };
+
+}
+
+#endif /*__MONITOR_HPP__*/
@@ -0,0 +1,152 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "perfcount.hpp"
+
+#ifdef CKNOT_PERF
+
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace CKnot
+{
+
+    namespace
+    {
+        ///One thread's counters, read together as a group so they cover the same span.
+        class Group
+        {
+            public:
+                Group()
+                    :mLeader(-1), mOpened(0)
+                {
+                    static const unsigned int types[PerfEventCount] =
+                        {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE};
+                    static const unsigned long long configs[PerfEventCount] =
+                        {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                         PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+                    for (int i = 0; i < PerfEventCount; ++i)
+                    {
+                        mFds[i] = Open(types[i], configs[i], mLeader);
+                        mSlots[i] = mFds[i] < 0 ? -1 : mOpened++;
+                        if (mLeader < 0)
+                            mLeader = mFds[i];
+                    }
+
+                    if (mLeader >= 0)
+                    {
+                        ioctl(mLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                        ioctl(mLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+                    }
+                }
+
+                ~Group()
+                {
+                    for (int i = 0; i < PerfEventCount; ++i)
+                        if (mFds[i] >= 0)
+                            close(mFds[i]);
+                }
+
+                PerfCounters Read() const
+                {
+                    PerfCounters ret;
+                    std::memset(&ret, 0, sizeof ret);
+
+                    //PERF_FORMAT_GROUP gives the number of events, then each value in the order they were opened.
+                    unsigned long long buf[PerfEventCount + 1];
+                    if (mLeader < 0 || read(mLeader, buf, sizeof buf) < ssize_t(sizeof(*buf) * (mOpened + 1)))
+                        return ret;
+
+                    for (int i = 0; i < PerfEventCount; ++i)
+                        if (mSlots[i] >= 0)
+                            ret.values[i] = buf[1 + mSlots[i]];
+
+                    return ret;
+                }
+
+                bool Has(PerfEvent event) const {return mSlots[event] >= 0;}
+
+            private:
+                static int Open(unsigned int type, unsigned long long config, int leader)
+                {
+                    perf_event_attr attr;
+                    std::memset(&attr, 0, sizeof attr);
+                    attr.size = sizeof attr;
+                    attr.type = type;
+                    attr.config = config;
+                    attr.disabled = leader < 0; //The group starts when its leader is enabled.
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+                    attr.read_format = PERF_FORMAT_GROUP;
+
+                    return int(syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+                }
+
+                int mFds[PerfEventCount];
+                int mSlots[PerfEventCount]; ///<Where each event comes in a group read, or -1 if it isn't open.
+                int mLeader;
+                int mOpened;
+        };
+
+        Group& GetGroup()
+        {
+            thread_local Group group;
+            return group;
+        }
+    }
+
+
+    PerfCounters ReadPerfCounters()
+    {
+        return GetGroup().Read();
+    }
+
+
+    bool HasPerfCounter(PerfEvent event)
+    {
+        return GetGroup().Has(event);
+    }
+
+}
+
+#else
+
+#include <cstring>
+
+namespace CKnot
+{
+
+    PerfCounters ReadPerfCounters()
+    {
+        PerfCounters ret;
+        std::memset(&ret, 0, sizeof ret);
+        return ret;
+    }
+
+
+    bool HasPerfCounter(PerfEvent)
+    {
+        return false;
+    }
+
+}
+
+#endif
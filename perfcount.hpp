@@ -0,0 +1,42 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PERFCOUNT_HPP__
+#define __PERFCOUNT_HPP__
+
+///Hardware performance counters.
+/**Build with CKNOT_PERF defined, on Linux, to have each thread open cycle, instruction, cache
+ * miss and branch miss counters with perf_event_open the first time it reads them. Stats phases
+ * then record what the CPU did inside them. Only user space is counted. Without CKNOT_PERF, or if
+ * the kernel refuses (see /proc/sys/kernel/perf_event_paranoid), the counters stay zero.
+ */
+namespace CKnot
+{
+
+    enum PerfEvent {PerfCycles, PerfInstructions, PerfCacheMisses, PerfBranchMisses, PerfEventCount};
+
+    struct PerfCounters
+    {
+        unsigned long long values[PerfEventCount]; ///<Running totals since the counters were opened.
+    };
+
+    PerfCounters ReadPerfCounters(); ///<Returns the counters for the calling thread.
+    bool HasPerfCounter(PerfEvent event); ///<Returns true if the calling thread could open the counter.
+
+}
+
+#endif /*__PERFCOUNT_HPP__*/
@@ -0,0 +1,367 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pick.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace CKnot
+{
+
+    namespace
+    {
+        const int Brackets = 16; ///<Pieces a segment is cut into to find each dip in its distance.
+        const int NewtonSteps = 30; ///<Most steps spent closing in on one dip, some of which may be bisections.
+        const size_t MaxCellsPerSegment = 16; ///<Caps the grid for knots of a few huge segments.
+
+        void Evaluate(const double c[4][2], double t, double p[2], double d[2], double dd[2])
+        {
+            for (int k = 0; k < 2; ++k)
+            {
+                p[k] = c[0][k] + t * (c[1][k] + t * (c[2][k] + t * c[3][k]));
+                d[k] = c[1][k] + t * (2 * c[2][k] + t * 3 * c[3][k]);
+                dd[k] = 2 * c[2][k] + t * 6 * c[3][k];
+            }
+        }
+
+        double Distance2(const double c[4][2], double t, double x, double y)
+        {
+            const double px = c[0][0] + t * (c[1][0] + t * (c[2][0] + t * c[3][0])) - x;
+            const double py = c[0][1] + t * (c[1][1] + t * (c[2][1] + t * c[3][1])) - y;
+            return px * px + py * py;
+        }
+
+        ///Returns half the slope of the squared distance from a point to the curve at t.
+        double Slope(const double c[4][2], double t, double x, double y)
+        {
+            double p[2], d[2], dd[2];
+            Evaluate(c, t, p, d, dd);
+            return (p[0] - x) * d[0] + (p[1] - y) * d[1];
+        }
+
+        ///Squared distance from a point to a box, 0 inside it.
+        double Distance2(const Box& b, double x, double y)
+        {
+            const double dx = x < b.min[0] ? b.min[0] - x : (x > b.max[0] ? x - b.max[0] : 0.0);
+            const double dy = y < b.min[1] ? b.min[1] - y : (y > b.max[1] ? y - b.max[1] : 0.0);
+            return dx * dx + dy * dy;
+        }
+    }
+
+
+    void PickIndex::Build(const Art& art)
+    {
+        CKNOT_TRACE_SCOPE("pick index");
+
+        Clear();
+
+        Box all = Box::Empty();
+        double extent = 0.0;
+
+        for (size_t i = 0; i < art.GetThreadCount(); ++i)
+        {
+            const Art::Thread& thread = *art.GetThread(i);
+            const Art::Z& z = *art.GetZ(i);
+
+            for (size_t j = 0; j + 1 < thread.GetKnotCount(); ++j)
+            {
+                const vec2 p0 = thread.GetKnotY(j), p1 = thread.GetKnotY(j + 1);
+                const vec2 m0 = thread.GetKnotM(j), m1 = thread.GetKnotM(j + 1);
+
+                //Hermite basis to powers of t.
+                const vec2 c2 = (p1 - p0) * 3.0 - m0 * 2.0 - m1;
+                const vec2 c3 = (p0 - p1) * 2.0 + m0 + m1;
+
+                Segment s;
+                s.c[0][0] = p0.x;
+                s.c[0][1] = p0.y;
+                s.c[1][0] = m0.x;
+                s.c[1][1] = m0.y;
+                s.c[2][0] = c2.x;
+                s.c[2][1] = c2.y;
+                s.c[3][0] = c3.x;
+                s.c[3][1] = c3.y;
+                s.box = GetSegmentBounds(thread, j, 1e-6); //A hair wider, for the rounding to float.
+                s.thread = (unsigned int)i;
+                s.index = (unsigned int)j;
+                s.param = thread.GetKnotX(j);
+                s.span = thread.GetKnotX(j + 1) - s.param;
+                s.over[0] = z.GetKnotY(j) > 0.0;
+                s.over[1] = z.GetKnotY(j + 1) > 0.0;
+                mSegments.push_back(s);
+
+                all.Add(s.box);
+                extent += std::max(s.box.max[0] - s.box.min[0], s.box.max[1] - s.box.min[1]);
+            }
+        }
+
+        if (mSegments.empty())
+            return;
+
+        //Cells about as big as a segment, so each lands in a few.
+        const double width = std::max(all.max[0] - all.min[0], 1e-6f);
+        const double height = std::max(all.max[1] - all.min[1], 1e-6f);
+        mCell = std::max(extent / mSegments.size(), 1e-6);
+        while ((width / mCell + 1) * (height / mCell + 1) > double(MaxCellsPerSegment * mSegments.size()))
+            mCell *= 2;
+
+        mLeft = all.min[0];
+        mTop = all.min[1];
+        mColumns = int(width / mCell) + 1;
+        mRows = int(height / mCell) + 1;
+
+        //Count each cell's segments, then place them, so the lists are one array.
+        mCellStart.assign(size_t(mColumns) * mRows + 1, 0);
+        for (int pass = 0; pass < 2; ++pass)
+        {
+            for (size_t i = 0; i < mSegments.size(); ++i)
+            {
+                const Box& b = mSegments[i].box;
+                const int x0 = int((b.min[0] - mLeft) / mCell), x1 = std::min(int((b.max[0] - mLeft) / mCell), mColumns - 1);
+                const int y0 = int((b.min[1] - mTop) / mCell), y1 = std::min(int((b.max[1] - mTop) / mCell), mRows - 1);
+
+                for (int y = y0; y <= y1; ++y)
+                {
+                    for (int x = x0; x <= x1; ++x)
+                    {
+                        const size_t cell = size_t(y) * mColumns + x;
+                        if (pass == 0)
+                            ++mCellStart[cell + 1];
+                        else
+                            mCellSegments[mCellStart[cell]++] = (unsigned int)i;
+                    }
+                }
+            }
+
+            if (pass == 0)
+            {
+                for (size_t c = 1; c < mCellStart.size(); ++c)
+                    mCellStart[c] += mCellStart[c - 1];
+                mCellSegments.resize(mCellStart.back());
+            }
+        }
+
+        //Placing moved each start to where the next cell starts.
+        for (size_t c = mCellStart.size() - 1; c > 0; --c)
+            mCellStart[c] = mCellStart[c - 1];
+        mCellStart[0] = 0;
+    }
+
+
+    void PickIndex::Clear()
+    {
+        mSegments.clear();
+        mCellStart.clear();
+        mCellSegments.clear();
+        mColumns = mRows = 0;
+    }
+
+
+    double PickIndex::Measure(const Segment& s, double x, double y, double& t) const
+    {
+        //The squared distance is a degree 6 polynomial, so has at most three dips. Each piece where its slope
+        //turns from falling to rising holds one, which Newton closes in on without leaving the piece. Only dips
+        //closer together than a piece could be missed, and then the one found is nearly as close.
+        double best = Distance2(s.c, 1.0, x, y);
+        t = 1.0;
+
+        double lo = 0.0;
+        double loSlope = Slope(s.c, 0.0, x, y);
+        for (int i = 1; i <= Brackets; ++i)
+        {
+            const double hi = double(i) / Brackets;
+            const double hiSlope = Slope(s.c, hi, x, y);
+
+            if (i == 1 && loSlope >= 0.0)
+            {
+                const double d = Distance2(s.c, 0.0, x, y);
+                if (d < best)
+                {
+                    best = d;
+                    t = 0.0;
+                }
+            }
+
+            if (loSlope < 0.0 && hiSlope >= 0.0)
+            {
+                double a = lo, b = hi;
+                double u = lo - loSlope * (hi - lo) / (hiSlope - loSlope);
+                for (int k = 0; k < NewtonSteps; ++k)
+                {
+                    double p[2], d[2], dd[2];
+                    Evaluate(s.c, u, p, d, dd);
+                    p[0] -= x;
+                    p[1] -= y;
+
+                    const double f = p[0] * d[0] + p[1] * d[1];
+                    if (f < 0.0)
+                        a = u;
+                    else
+                        b = u;
+
+                    //Steps that would leave the bracket halve it instead.
+                    const double slope = d[0] * d[0] + d[1] * d[1] + p[0] * dd[0] + p[1] * dd[1];
+                    double next = slope > 0.0 ? u - f / slope : a - 1.0;
+                    if (next <= a || next >= b)
+                        next = (a + b) * 0.5;
+
+                    const bool done = std::fabs(next - u) < 1e-12 || b - a < 1e-12;
+                    u = next;
+                    if (done)
+                        break;
+                }
+
+                const double d = Distance2(s.c, u, x, y);
+                if (d < best)
+                {
+                    best = d;
+                    t = u;
+                }
+            }
+
+            lo = hi;
+            loSlope = hiSlope;
+        }
+
+        return best;
+    }
+
+
+    void PickIndex::Fill(const Segment& s, double t, double distance2, Pick& pick) const
+    {
+        double p[2], d[2], dd[2];
+        Evaluate(s.c, t, p, d, dd);
+
+        pick.thread = s.thread;
+        pick.segment = s.index;
+        pick.t = t;
+        pick.param = s.param + s.span * t;
+        pick.x = p[0];
+        pick.y = p[1];
+        pick.distance = std::sqrt(distance2);
+        pick.over = s.over[t < 0.5 ? 0 : 1];
+    }
+
+
+    bool PickIndex::Find(double x, double y, double maxDistance, Pick& pick) const
+    {
+        if (mSegments.empty())
+            return false;
+
+        double best = maxDistance * maxDistance;
+        const Segment* hit = 0;
+        double hitT = 0.0;
+
+        //Points off the grid search out from the nearest cell. Everything on the grid is at least as far from the
+        //point as from where it meets the grid, and then some.
+        const double qx = std::min(std::max(x, mLeft), mLeft + mColumns * mCell);
+        const double qy = std::min(std::max(y, mTop), mTop + mRows * mCell);
+        const double off = (x - qx) * (x - qx) + (y - qy) * (y - qy);
+
+        const int cx = std::min(int((qx - mLeft) / mCell), mColumns - 1);
+        const int cy = std::min(int((qy - mTop) / mCell), mRows - 1);
+        const int rings = std::max(std::max(cx, mColumns - 1 - cx), std::max(cy, mRows - 1 - cy));
+
+        for (int r = 0; r <= rings; ++r)
+        {
+            //Before ring r, everything unsearched is outside the square of rings so far. Sides at the edge of the
+            //grid have nothing past them, so only the others bound how near it can be.
+            double gap = 1e300;
+            if (cx - r >= 0)
+                gap = std::min(gap, qx - (mLeft + (cx - r + 1) * mCell));
+            if (cx + r < mColumns)
+                gap = std::min(gap, mLeft + (cx + r) * mCell - qx);
+            if (cy - r >= 0)
+                gap = std::min(gap, qy - (mTop + (cy - r + 1) * mCell));
+            if (cy + r < mRows)
+                gap = std::min(gap, mTop + (cy + r) * mCell - qy);
+            if (r > 0 && off + gap * gap > best)
+                break;
+
+            for (int gy = std::max(cy - r, 0); gy <= std::min(cy + r, mRows - 1); ++gy)
+            {
+                //Inner rows only have the two cells at the ring's ends.
+                const bool edge = gy == cy - r || gy == cy + r;
+                const int step = edge ? 1 : 2 * r;
+
+                for (int gx = cx - r; gx <= cx + r; gx += std::max(step, 1))
+                {
+                    if (gx < 0 || gx >= mColumns)
+                        continue;
+
+                    const size_t cell = size_t(gy) * mColumns + gx;
+                    for (unsigned int k = mCellStart[cell]; k < mCellStart[cell + 1]; ++k)
+                    {
+                        const Segment& s = mSegments[mCellSegments[k]];
+                        if (Distance2(s.box, x, y) >= best)
+                            continue;
+
+                        double t;
+                        const double d = Measure(s, x, y, t);
+                        if (d < best)
+                        {
+                            best = d;
+                            hit = &s;
+                            hitT = t;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (!hit)
+            return false;
+
+        Fill(*hit, hitT, best, pick);
+        return true;
+    }
+
+
+    bool PickIndex::FindByScan(double x, double y, double maxDistance, Pick& pick) const
+    {
+        double best = maxDistance * maxDistance;
+        const Segment* hit = 0;
+        double hitT = 0.0;
+
+        for (size_t i = 0; i < mSegments.size(); ++i)
+        {
+            double t;
+            const double d = Measure(mSegments[i], x, y, t);
+            if (d < best)
+            {
+                best = d;
+                hit = &mSegments[i];
+                hitT = t;
+            }
+        }
+
+        if (!hit)
+            return false;
+
+        Fill(*hit, hitT, best, pick);
+        return true;
+    }
+
+
+    size_t PickIndex::GetBytes() const
+    {
+        return mSegments.capacity() * sizeof(Segment) + (mCellStart.capacity() + mCellSegments.capacity()) * sizeof(unsigned int);
+    }
+
+}
@@ -0,0 +1,89 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PICK_HPP__
+#define __PICK_HPP__
+
+#include <vector>
+#include "cknot.hpp"
+#include "mesh.hpp"
+
+namespace CKnot
+{
+
+    ///The place on a thread closest to a point.
+    struct Pick
+    {
+        size_t thread;
+        size_t segment; ///<The curve between knots segment and segment + 1.
+        double t; ///<How far along the segment, from 0 to 1.
+        double param; ///<The same place in the thread spline's own parameter.
+        double x, y; ///<The closest point.
+        double distance;
+        bool over; ///<Whether the thread crosses over here.
+    };
+
+
+    ///Finds which thread is nearest a point, and where on it, without looking at every segment.
+    /**Segments are binned by their GetSegmentBounds box into a uniform grid with cells about the size of a
+     * segment. A query searches rings of cells out from the point, stopping once no cell left can hold anything
+     * closer than the best so far, and skips segments whose box is already too far. What is left is measured
+     * exactly: the nearest of a few samples along the segment starts Newton's method on (H(t) - p).H'(t) = 0,
+     * where H is the segment's Hermite cubic. The nearest centre line wins, so on a crossing that is whichever
+     * thread's middle is closer, over or under.
+     * The index keeps its own copy of each segment's curve, so the art may go away once it is built.
+     * Queries don't change anything, so any number of threads may run them at once.
+     */
+    class PickIndex
+    {
+        public:
+            PickIndex():mLeft(0), mTop(0), mCell(1), mColumns(0), mRows(0){}
+
+            void Build(const Art& art);
+            void Clear();
+
+            ///Finds the closest point of any thread to x, y, if one is within maxDistance.
+            bool Find(double x, double y, double maxDistance, Pick& pick) const;
+            bool FindByScan(double x, double y, double maxDistance, Pick& pick) const; ///<Like Find, but measures every segment. For checking Find.
+
+            size_t GetSegmentCount() const {return mSegments.size();}
+            size_t GetBytes() const; ///<Returns roughly how much memory the index holds.
+
+        private:
+            struct Segment
+            {
+                double c[4][2]; ///<The cubic is c[0] + c[1] t + c[2] t^2 + c[3] t^3.
+                Box box;
+                unsigned int thread, index;
+                double param, span; ///<Thread parameter at the start, and how far it goes.
+                bool over[2]; ///<Whether the first and second halves cross over.
+            };
+
+            double Measure(const Segment& s, double x, double y, double& t) const; ///<Returns the squared distance to the nearest point, at t.
+            void Fill(const Segment& s, double t, double distance2, Pick& pick) const;
+
+            std::vector<Segment> mSegments;
+            std::vector<unsigned int> mCellStart; ///<Where each cell's list starts in mCellSegments, and one past the last.
+            std::vector<unsigned int> mCellSegments;
+
+            double mLeft, mTop, mCell; ///<Corner and side of the grid's cells.
+            int mColumns, mRows;
+    };
+
+}
+
+#endif /*__PICK_HPP__*/
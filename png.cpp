@@ -0,0 +1,264 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "png.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace CKnot
+{
+
+    namespace
+    {
+        ///Tables built once, on first use from any thread.
+        struct Tables
+        {
+            unsigned int crc[256];
+            unsigned short code[288]; ///<Fixed Huffman code of each literal and length symbol, bit reversed for writing.
+            unsigned char length[288];
+
+            Tables()
+            {
+                for (unsigned int i = 0; i < 256; ++i)
+                {
+                    unsigned int c = i;
+                    for (int k = 0; k < 8; ++k)
+                        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    crc[i] = c;
+                }
+
+                for (unsigned int lit = 0; lit < 288; ++lit)
+                {
+                    unsigned int c;
+                    int n;
+                    if (lit < 144)
+                        c = 0x30 + lit, n = 8;
+                    else if (lit < 256)
+                        c = 0x190 + lit - 144, n = 9;
+                    else if (lit < 280)
+                        c = lit - 256, n = 7;
+                    else
+                        c = 0xc0 + lit - 280, n = 8;
+
+                    code[lit] = (unsigned short)Reverse(c, n);
+                    length[lit] = (unsigned char)n;
+                }
+            }
+
+            ///Huffman codes go most significant bit first into a stream written least significant bit first.
+            static unsigned int Reverse(unsigned int code, int count)
+            {
+                unsigned int reversed = 0;
+                for (int i = 0; i < count; ++i)
+                    reversed |= ((code >> i) & 1) << (count - 1 - i);
+                return reversed;
+            }
+        };
+
+        const Tables& GetTables()
+        {
+            static const Tables tables;
+            return tables;
+        }
+
+        unsigned int Crc32(const unsigned char* data, size_t n)
+        {
+            const unsigned int* table = GetTables().crc;
+            unsigned int crc = 0xffffffffu;
+            for (size_t i = 0; i < n; ++i)
+                crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        void PutBig(std::string& out, unsigned int v)
+        {
+            out += char(v >> 24);
+            out += char(v >> 16);
+            out += char(v >> 8);
+            out += char(v);
+        }
+
+        void PutChunk(std::string& out, const char* type, const std::string& data)
+        {
+            PutBig(out, (unsigned int)data.size());
+            const size_t start = out.size();
+            out.append(type, 4);
+            out += data;
+            PutBig(out, Crc32((const unsigned char*)out.data() + start, out.size() - start));
+        }
+
+        ///Writes a deflate stream least significant bit first.
+        class BitWriter
+        {
+            public:
+                explicit BitWriter(std::string& out):mOut(out), mBits(0), mCount(0){}
+
+                void Put(unsigned int bits, int count)
+                {
+                    mBits |= (unsigned long long)bits << mCount;
+                    mCount += count;
+                    if (mCount >= 32)
+                    {
+                        const char bytes[4] = {char(mBits), char(mBits >> 8), char(mBits >> 16), char(mBits >> 24)};
+                        mOut.append(bytes, 4);
+                        mBits >>= 32;
+                        mCount -= 32;
+                    }
+                }
+
+                void PutLiteral(const Tables& tables, unsigned int lit) {Put(tables.code[lit], tables.length[lit]);}
+
+                void Flush()
+                {
+                    for (; mCount > 0; mCount -= 8)
+                    {
+                        mOut += char(mBits & 0xff);
+                        mBits >>= 8;
+                    }
+                    mBits = 0;
+                    mCount = 0;
+                }
+
+            private:
+                std::string& mOut;
+                unsigned long long mBits;
+                int mCount;
+        };
+
+        ///A repeat of length 3 to 258 at distance 1.
+        void PutRepeat(BitWriter& bw, const Tables& tables, unsigned int length)
+        {
+            static const unsigned short base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+            static const unsigned char extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+            int code = 28;
+            while (base[code] > length)
+                --code;
+
+            bw.PutLiteral(tables, 257 + code);
+            bw.Put(length - base[code], extra[code]);
+            bw.Put(0, 5); //Distance 1.
+        }
+
+        void Deflate(const std::vector<unsigned char>& data, std::string& out)
+        {
+            const Tables& tables = GetTables();
+
+            out.reserve(out.size() + data.size() / 4);
+            out += char(0x78); //zlib header, 32K window, no dictionary.
+            out += char(0x01);
+
+            BitWriter bw(out);
+            bw.Put(1, 1); //Last block.
+            bw.Put(1, 2); //Fixed Huffman codes.
+
+            const size_t n = data.size();
+            const unsigned char* p = n ? &data.front() : 0;
+            size_t i = 0;
+            while (i < n)
+            {
+                bw.PutLiteral(tables, p[i]);
+
+                const size_t limit = std::min(n - i - 1, size_t(258));
+                size_t run = 0;
+                while (run < limit && p[i + 1 + run] == p[i])
+                    ++run;
+
+                if (run >= 3)
+                {
+                    PutRepeat(bw, tables, (unsigned int)run);
+                    i += 1 + run;
+                }
+                else
+                    ++i;
+            }
+
+            bw.PutLiteral(tables, 256);
+            bw.Flush();
+
+            //Adler-32, reducing modulo 65521 every 5552 bytes, the most that can't overflow.
+            unsigned int a = 1, b = 0;
+            for (size_t k = 0; k < n;)
+            {
+                const size_t end = std::min(n, k + 5552);
+                for (; k < end; ++k)
+                {
+                    a += p[k];
+                    b += a;
+                }
+                a %= 65521;
+                b %= 65521;
+            }
+            PutBig(out, (b << 16) | a);
+        }
+    }
+
+
+    void EncodePNG(const unsigned char* pixels, int width, int height, std::string& out)
+    {
+        out.assign("\x89PNG\r\n\x1a\n", 8);
+
+        std::string header;
+        PutBig(header, width);
+        PutBig(header, height);
+        header += char(8); //Bit depth.
+        header += char(2); //RGB.
+        header += char(0);
+        header += char(0);
+        header += char(0);
+        PutChunk(out, "IHDR", header);
+
+        const size_t stride = size_t(width) * 3;
+        std::vector<unsigned char> filtered((stride + 1) * height);
+
+        for (int y = 0; y < height; ++y)
+        {
+            const unsigned char* row = pixels + y * stride;
+            unsigned char* f = &filtered[y * (stride + 1)];
+
+            f[0] = 1; //Sub: each byte less the same channel of the pixel to its left.
+            for (size_t x = 0; x < stride && x < 3; ++x)
+                f[1 + x] = row[x];
+            for (size_t x = 3; x < stride; ++x)
+                f[1 + x] = (unsigned char)(row[x] - row[x - 3]);
+        }
+
+        std::string data;
+        Deflate(filtered, data);
+        PutChunk(out, "IDAT", data);
+        PutChunk(out, "IEND", std::string());
+    }
+
+
+    bool WritePNG(const char* path, const unsigned char* pixels, int width, int height)
+    {
+        std::string png;
+        EncodePNG(pixels, width, height, png);
+
+        FILE* f = std::fopen(path, "wb");
+        if (!f)
+            return false;
+
+        const bool ok = std::fwrite(png.data(), 1, png.size(), f) == png.size();
+        return std::fclose(f) == 0 && ok;
+    }
+
+}
@@ -0,0 +1,37 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PNG_HPP__
+#define __PNG_HPP__
+
+#include <string>
+
+namespace CKnot
+{
+
+    ///Encodes 8 bit RGB pixels, rows from top to bottom, as a PNG.
+    /**Needs no zlib. Rows use the Sub filter, which turns flat colour into runs of zeros, and the deflate stream
+     * only codes literals and repeats of the last byte with the fixed Huffman table. That keeps it fast and small
+     * for pictures like ours, which are mostly background, though far from what zlib gets on photos.
+     */
+    void EncodePNG(const unsigned char* pixels, int width, int height, std::string& out);
+
+    bool WritePNG(const char* path, const unsigned char* pixels, int width, int height); ///<Saves pixels as a PNG file.
+
+}
+
+#endif /*__PNG_HPP__*/
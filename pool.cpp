@@ -0,0 +1,219 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pool.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include "trace.hpp"
+
+#ifdef CKNOT_STATS
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace CKnot
+{
+
+    Pool::Pool(size_t threads)
+        :mBatch(0), mQuit(false), mJob(0), mContext(0), mPending(0)
+    {
+        if (!threads)
+            threads = std::thread::hardware_concurrency();
+        if (!threads)
+            threads = 1;
+
+        for (size_t i = 0; i < threads; ++i)
+            mQueues.push_back(new Queue);
+
+        mCounters.resize(threads);
+        for (size_t i = 1; i < threads; ++i)
+            mThreads.push_back(std::thread(&Pool::Work, this, i));
+    }
+
+
+    Pool::~Pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mQuit = true;
+        }
+        mWake.notify_all();
+
+        for (size_t i = 0; i < mThreads.size(); ++i)
+            mThreads[i].join();
+
+        for (size_t i = 0; i < mQueues.size(); ++i)
+            delete mQueues[i];
+    }
+
+
+    void Pool::Run(size_t count, Job job, void* context)
+    {
+        if (!count)
+            return;
+
+        std::lock_guard<std::mutex> run(mRunLock);
+
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+
+            mJob = job;
+            mContext = context;
+            mPending = count;
+
+            //Neighbouring jobs tend to touch neighbouring memory, so give each thread a block.
+            const size_t n = mQueues.size();
+            for (size_t q = 0; q < n; ++q)
+            {
+                std::lock_guard<std::mutex> ql(mQueues[q]->lock);
+                for (size_t i = q * count / n; i < (q + 1) * count / n; ++i)
+                    mQueues[q]->items.push_back(i);
+            }
+
+            ++mBatch;
+        }
+        mWake.notify_all();
+
+        while (RunOne(0))
+            ;
+
+        std::unique_lock<std::mutex> lock(mLock);
+        while (mPending.load())
+            mDone.wait(lock);
+    }
+
+
+    double Pool::GetCpuTime()
+    {
+        double total = 0.0;
+#ifdef CKNOT_STATS
+        for (size_t i = 0; i < mThreads.size(); ++i)
+        {
+            clockid_t clock;
+            timespec ts;
+            if (pthread_getcpuclockid(mThreads[i].native_handle(), &clock) == 0 && clock_gettime(clock, &ts) == 0)
+                total += double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+        }
+#endif
+        return total;
+    }
+
+
+    AllocCounters Pool::GetAllocCounters() const
+    {
+        AllocCounters total = {0, 0, 0, 0};
+
+        std::lock_guard<std::mutex> lock(mLock);
+        for (size_t i = 1; i < mCounters.size(); ++i)
+        {
+            if (!mCounters[i])
+                continue;
+            total.count += mCounters[i]->count;
+            total.bytes += mCounters[i]->bytes;
+            total.live += mCounters[i]->live;
+            total.peak = std::max(total.peak, mCounters[i]->peak);
+        }
+        return total;
+    }
+
+
+    void Pool::Work(size_t self)
+    {
+        char name[32];
+        std::snprintf(name, sizeof name, "pool %lu", (unsigned long)self);
+        Trace::SetThreadName(name);
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mCounters[self] = &CKnot::GetAllocCounters();
+        }
+
+        size_t seen = 0;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mLock);
+                while (!mQuit && mBatch == seen)
+                    mWake.wait(lock);
+
+                if (mQuit)
+                    return;
+
+                seen = mBatch;
+            }
+
+            while (RunOne(self))
+                ;
+        }
+    }
+
+
+    bool Pool::RunOne(size_t self)
+    {
+        size_t index = 0;
+        bool found = false;
+
+        //Our own work first, from the back, then steal from the front of the others.
+        {
+            Queue& q = *mQueues[self];
+            std::lock_guard<std::mutex> lock(q.lock);
+            if (!q.items.empty())
+            {
+                index = q.items.back();
+                q.items.pop_back();
+                found = true;
+            }
+        }
+
+        for (size_t i = 1; !found && i < mQueues.size(); ++i)
+        {
+            Queue& q = *mQueues[(self + i) % mQueues.size()];
+            std::lock_guard<std::mutex> lock(q.lock);
+            if (!q.items.empty())
+            {
+                index = q.items.front();
+                q.items.pop_front();
+                found = true;
+            }
+        }
+
+        if (!found)
+            return false;
+
+        mJob(mContext, index);
+
+        if (mPending.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            mDone.notify_all();
+        }
+
+        return true;
+    }
+
+
+    void ParallelFor(Pool* pool, size_t count, Pool::Job job, void* context)
+    {
+        if (pool)
+            pool->Run(count, job, context);
+        else
+            for (size_t i = 0; i < count; ++i)
+                job(context, i);
+    }
+
+}
@@ -0,0 +1,89 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __POOL_HPP__
+#define __POOL_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "alloc.hpp"
+
+namespace CKnot
+{
+
+    ///A fixed set of threads that run batches of small jobs, balancing them by work stealing.
+    /**Run hands out the indices of a batch in even blocks, one per thread. Each thread takes from the back
+     * of its own block, and once that is empty steals from the front of the others, so uneven jobs still
+     * keep every thread busy. The thread calling Run works on the batch too, then waits for the rest.
+     * One batch runs at a time, and jobs must not call Run.
+     */
+    class Pool
+    {
+        public:
+            typedef void (*Job)(void* context, size_t index);
+
+            explicit Pool(size_t threads = 0); ///<Makes a pool of threads threads, counting the caller's. 0 is one per core.
+            ~Pool();
+
+            size_t GetThreadCount() const {return mQueues.size();}
+
+            void Run(size_t count, Job job, void* context); ///<Calls job(context, i) for each i below count, returning when all are done.
+
+            //What the started threads have used, so a caller can add it to its own. Only call between batches.
+            double GetCpuTime(); ///<Returns the started threads' CPU time in seconds. 0 without CKNOT_STATS.
+            AllocCounters GetAllocCounters() const; ///<Adds up the started threads' allocation counters.
+
+        private:
+            Pool(const Pool&);
+            Pool& operator=(const Pool&);
+
+            struct Queue
+            {
+                std::mutex lock;
+                std::deque<size_t> items;
+            };
+
+            void Work(size_t self); ///<Body of each started thread.
+            bool RunOne(size_t self); ///<Runs one job from our own queue or someone else's. Returns false if there were none.
+
+            std::vector<Queue*> mQueues; ///<One per thread, the caller's is first.
+            std::vector<std::thread> mThreads;
+            std::vector<const AllocCounters*> mCounters; ///<Each started thread's, once it has begun. Guarded by mLock.
+
+            std::mutex mRunLock; ///<Lets one batch in at a time.
+            mutable std::mutex mLock; ///<Guards the fields below, and waking up.
+            std::condition_variable mWake, mDone;
+            size_t mBatch; ///<Counts batches, so sleeping threads can tell a new one has started.
+            bool mQuit;
+
+            Job mJob;
+            void* mContext;
+            std::atomic<size_t> mPending; ///<Jobs of the batch not finished yet.
+    };
+
+
+    ///Runs job over count indices on the pool, or one after another on this thread if pool is null.
+    void ParallelFor(Pool* pool, size_t count, Pool::Job job, void* context);
+
+}
+
+#endif /*__POOL_HPP__*/
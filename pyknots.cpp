@@ -0,0 +1,636 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Python bindings. Builds the celtic_knots module, for making knots by the million
+//from Python. The work runs with the GIL released, so Python threads can make
+//knots side by side. Results are returned as Array objects, which hand their
+//memory to numpy.asarray or memoryview through the buffer protocol without a
+//copy: the points and tangents of a knot are the spline's own storage and the
+//vertices of a mesh are its strips.
+//
+//  import celtic_knots, numpy
+//  knot = celtic_knots.make_knot(seed=7, aspect=16 / 9)
+//  points = numpy.asarray(knot.points(0))      #(n, 2) float64, no copy
+//  ribbon = numpy.asarray(knot.mesh().vertices(0)) #(m, 6) float32: x y z r g b
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "cknot.hpp"
+#include "lattice.hpp"
+#include "mesh.hpp"
+
+using namespace CKnot;
+
+namespace
+{
+
+    ///Memory an Array holds itself, rather than borrows from its owner.
+    struct Storage
+    {
+        virtual ~Storage(){}
+    };
+
+    template <typename T>
+        struct VectorStorage : Storage
+    {
+        std::vector<T> values;
+    };
+
+
+    struct ArrayObject
+    {
+        PyObject_HEAD
+        PyObject* owner; ///<Whose memory data is in, kept alive by the array. Null if storage holds it.
+        Storage* storage;
+        void* data;
+        const char* format; ///<"d" or "f".
+        Py_ssize_t itemsize;
+        int ndim;
+        Py_ssize_t shape[2];
+        Py_ssize_t strides[2];
+        bool readonly;
+    };
+
+
+    struct StrokesObject
+    {
+        PyObject_HEAD
+        StrokeList* strokes;
+        unsigned int state; ///<Random state after the strokes were made, for the colours of meshes.
+        std::vector<double>* table; ///<ax, ay, bx, by, type of each stroke.
+    };
+
+
+    struct KnotObject
+    {
+        PyObject_HEAD
+        Art* art;
+        unsigned int state;
+        std::mutex* lock; ///<Held while the splines are evaluated, as they remember where the last lookup was.
+    };
+
+
+    struct MeshObject
+    {
+        PyObject_HEAD
+        Arrays* arrays; ///<One quad strip per thread, x, y, z, r, g, b a vertex.
+    };
+
+
+    PyTypeObject ArrayType = {PyVarObject_HEAD_INIT(0, 0)};
+    PyTypeObject StrokesType = {PyVarObject_HEAD_INIT(0, 0)};
+    PyTypeObject KnotType = {PyVarObject_HEAD_INIT(0, 0)};
+    PyTypeObject MeshType = {PyVarObject_HEAD_INIT(0, 0)};
+
+
+    ///Returns a new array of rows by cols items over data. With cols 0 the array has one dimension.
+    /**Owner is kept alive while the array is, and storage, if given, is deleted with it.
+     */
+    PyObject* NewArray(PyObject* owner, Storage* storage, void* data, const char* format, Py_ssize_t itemsize,
+            Py_ssize_t rows, Py_ssize_t cols, bool readonly)
+    {
+        ArrayObject* self = PyObject_New(ArrayObject, &ArrayType);
+        if (!self)
+        {
+            delete storage;
+            return 0;
+        }
+
+        Py_XINCREF(owner);
+        self->owner = owner;
+        self->storage = storage;
+        self->data = data;
+        self->format = format;
+        self->itemsize = itemsize;
+        self->ndim = cols ? 2 : 1;
+        self->shape[0] = rows;
+        self->shape[1] = cols;
+        self->strides[0] = itemsize * (cols ? cols : 1);
+        self->strides[1] = itemsize;
+        self->readonly = readonly;
+        return reinterpret_cast<PyObject*>(self);
+    }
+
+
+    void ArrayDealloc(PyObject* obj)
+    {
+        ArrayObject* self = reinterpret_cast<ArrayObject*>(obj);
+        Py_XDECREF(self->owner);
+        delete self->storage;
+        PyObject_Free(self);
+    }
+
+
+    int ArrayGetBuffer(PyObject* obj, Py_buffer* view, int flags)
+    {
+        ArrayObject* self = reinterpret_cast<ArrayObject*>(obj);
+        if ((flags & PyBUF_WRITABLE) && self->readonly)
+        {
+            PyErr_SetString(PyExc_BufferError, "array is read only");
+            return -1;
+        }
+
+        //Always C contiguous, so any request can be met.
+        Py_INCREF(obj);
+        view->obj = obj;
+        view->buf = self->data;
+        view->len = self->shape[0] * self->strides[0];
+        view->readonly = self->readonly;
+        view->itemsize = self->itemsize;
+        view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(self->format) : 0;
+        view->ndim = self->ndim;
+        view->shape = (flags & PyBUF_ND) ? self->shape : 0;
+        view->suboffsets = 0;
+        view->internal = 0;
+
+        //One dimensional arrays step by the item, which is the second stride.
+        view->strides = 0;
+        if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES)
+            view->strides = self->ndim == 2 ? self->strides : self->strides + 1;
+
+        return 0;
+    }
+
+
+    Py_ssize_t ArrayLength(PyObject* obj)
+    {
+        return reinterpret_cast<ArrayObject*>(obj)->shape[0];
+    }
+
+
+    PyObject* ArrayGetShape(PyObject* obj, void*)
+    {
+        ArrayObject* self = reinterpret_cast<ArrayObject*>(obj);
+        return self->ndim == 2 ? Py_BuildValue("(nn)", self->shape[0], self->shape[1]) : Py_BuildValue("(n)", self->shape[0]);
+    }
+
+
+    PyBufferProcs ArrayBuffer = {ArrayGetBuffer, 0};
+    PySequenceMethods ArraySequence = {ArrayLength};
+    PyGetSetDef ArrayGetSet[] = {
+        {"shape", ArrayGetShape, 0, "Rows, and columns if there are any.", 0},
+        {0, 0, 0, 0, 0}
+    };
+
+
+    ///Reads the lattice options shared by make_strokes and make_knot.
+    bool ParseLattice(PyObject* args, PyObject* kwargs, unsigned int& seed, double& aspect, LatticeParams& lattice)
+    {
+        static const char* keywords[] = {"seed", "aspect", "density", "bounce", "glance", "removal", 0};
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "I|ddddd", const_cast<char**>(keywords), &seed, &aspect,
+                    &lattice.junctionsPer, &lattice.bounce, &lattice.glance, &lattice.removal))
+            return false;
+
+        if (aspect <= 0.0 || lattice.junctionsPer < 0.0 || lattice.removal < 0.0 || lattice.removal >= 1.0)
+        {
+            PyErr_SetString(PyExc_ValueError, "aspect must be positive, density at least 0 and removal from 0 to under 1");
+            return false;
+        }
+        return true;
+    }
+
+
+    ///Makes the strokes of a knot as Engine::NewArt does, leaving random where it would.
+    StrokeList MakeStrokes(Random& random, double aspect, const LatticeParams& lattice)
+    {
+        StrokeList strokes = CreateSquareStrokes(random, aspect, 1.0, lattice);
+        return RemoveStrokes(random, strokes, lattice);
+    }
+
+
+    ///Takes the strokes, leaving the list empty.
+    PyObject* NewStrokes(StrokeList& strokes, unsigned int state)
+    {
+        StrokesObject* self = PyObject_New(StrokesObject, &StrokesType);
+        if (!self)
+            return 0;
+
+        self->strokes = new StrokeList;
+        self->strokes->swap(strokes);
+        self->state = state;
+        self->table = new std::vector<double>;
+        self->table->reserve(self->strokes->size() * 5);
+        for (StrokeList::const_iterator it = self->strokes->begin(); it != self->strokes->end(); ++it)
+        {
+            self->table->push_back(it->a.x);
+            self->table->push_back(it->a.y);
+            self->table->push_back(it->b.x);
+            self->table->push_back(it->b.y);
+            self->table->push_back(double(it->type));
+        }
+        return reinterpret_cast<PyObject*>(self);
+    }
+
+
+    void StrokesDealloc(PyObject* obj)
+    {
+        StrokesObject* self = reinterpret_cast<StrokesObject*>(obj);
+        delete self->strokes;
+        delete self->table;
+        PyObject_Free(self);
+    }
+
+
+    Py_ssize_t StrokesLength(PyObject* obj)
+    {
+        return Py_ssize_t(reinterpret_cast<StrokesObject*>(obj)->strokes->size());
+    }
+
+
+    PyObject* StrokesArray(PyObject* obj, PyObject*)
+    {
+        StrokesObject* self = reinterpret_cast<StrokesObject*>(obj);
+        std::vector<double>& table = *self->table;
+        return NewArray(obj, 0, table.empty() ? 0 : &table.front(), "d", sizeof(double),
+                Py_ssize_t(table.size() / 5), 5, true);
+    }
+
+
+    PyObject* NewKnot(AutoArt art, unsigned int state)
+    {
+        KnotObject* self = PyObject_New(KnotObject, &KnotType);
+        if (!self)
+            return 0;
+
+        self->art = art.release();
+        self->state = state;
+        self->lock = new std::mutex;
+        return reinterpret_cast<PyObject*>(self);
+    }
+
+
+    void KnotDealloc(PyObject* obj)
+    {
+        KnotObject* self = reinterpret_cast<KnotObject*>(obj);
+        delete self->art;
+        delete self->lock;
+        PyObject_Free(self);
+    }
+
+
+    Py_ssize_t KnotLength(PyObject* obj)
+    {
+        return Py_ssize_t(reinterpret_cast<KnotObject*>(obj)->art->GetThreadCount());
+    }
+
+
+    ///Reads a thread index argument. Returns false, with an exception set, if it isn't one.
+    bool ParseThread(KnotObject* self, PyObject* args, Py_ssize_t& thread)
+    {
+        if (!PyArg_ParseTuple(args, "n", &thread))
+            return false;
+        if (thread < 0 || size_t(thread) >= self->art->GetThreadCount())
+        {
+            PyErr_SetString(PyExc_IndexError, "no such thread");
+            return false;
+        }
+        return true;
+    }
+
+
+    PyObject* KnotParams(PyObject* obj, PyObject* args)
+    {
+        KnotObject* self = reinterpret_cast<KnotObject*>(obj);
+        Py_ssize_t i;
+        if (!ParseThread(self, args, i))
+            return 0;
+
+        const Art::Thread* thread = self->art->GetThread(size_t(i));
+        return NewArray(obj, 0, const_cast<double*>(thread->GetKnotXs()), "d", sizeof(double),
+                Py_ssize_t(thread->GetKnotCount()), 0, true);
+    }
+
+
+    PyObject* KnotPoints(PyObject* obj, PyObject* args)
+    {
+        KnotObject* self = reinterpret_cast<KnotObject*>(obj);
+        Py_ssize_t i;
+        if (!ParseThread(self, args, i))
+            return 0;
+
+        const Art::Thread* thread = self->art->GetThread(size_t(i));
+        return NewArray(obj, 0, const_cast<vec2*>(thread->GetKnotYs()), "d", sizeof(double),
+                Py_ssize_t(thread->GetKnotCount()), 2, true);
+    }
+
+
+    PyObject* KnotTangents(PyObject* obj, PyObject* args)
+    {
+        KnotObject* self = reinterpret_cast<KnotObject*>(obj);
+        Py_ssize_t i;
+        if (!ParseThread(self, args, i))
+            return 0;
+
+        const Art::Thread* thread = self->art->GetThread(size_t(i));
+        return NewArray(obj, 0, const_cast<vec2*>(thread->GetKnotMs()), "d", sizeof(double),
+                Py_ssize_t(thread->GetKnotCount()), 2, true);
+    }
+
+
+    PyObject* KnotDepths(PyObject* obj, PyObject* args)
+    {
+        KnotObject* self = reinterpret_cast<KnotObject*>(obj);
+        Py_ssize_t i;
+        if (!ParseThread(self, args, i))
+            return 0;
+
+        const Art::Z* z = self->art->GetZ(size_t(i));
+        return NewArray(obj, 0, const_cast<double*>(z->GetKnotYs()), "d", sizeof(double),
+                Py_ssize_t(z->GetKnotCount()), 0, true);
+    }
+
+
+    PyObject* KnotEvaluate(PyObject* obj, PyObject* args)
+    {
+        KnotObject* self = reinterpret_cast<KnotObject*>(obj);
+        Py_ssize_t i;
+        PyObject* at;
+        if (!PyArg_ParseTuple(args, "nO", &i, &at))
+            return 0;
+        if (i < 0 || size_t(i) >= self->art->GetThreadCount())
+        {
+            PyErr_SetString(PyExc_IndexError, "no such thread");
+            return 0;
+        }
+
+        Py_buffer in;
+        if (PyObject_GetBuffer(at, &in, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+            return 0;
+
+        const size_t n = size_t(in.len / sizeof(double));
+        if (in.itemsize != sizeof(double) || !in.format || in.format[std::strlen(in.format) - 1] != 'd')
+        {
+            PyBuffer_Release(&in);
+            PyErr_SetString(PyExc_TypeError, "parameters must be a contiguous float64 buffer");
+            return 0;
+        }
+
+        //A NaN or infinite parameter has no segment to wrap around to, see Spline::GetIndex.
+        const double* x = static_cast<const double*>(in.buf);
+        for (size_t k = 0; k < n; ++k)
+        {
+            if (!std::isfinite(x[k]))
+            {
+                PyBuffer_Release(&in);
+                PyErr_SetString(PyExc_ValueError, "parameters must be finite");
+                return 0;
+            }
+        }
+
+        VectorStorage<double>* out = new VectorStorage<double>;
+        out->values.resize(n * 2);
+
+        const Art::Thread* thread = self->art->GetThread(size_t(i));
+        double* y = out->values.empty() ? 0 : &out->values.front();
+
+        Py_BEGIN_ALLOW_THREADS
+        {
+            //Nearby parameters in order find their segment in a step or two, see Spline::GetIndex.
+            std::lock_guard<std::mutex> hold(*self->lock);
+            for (size_t k = 0; k < n; ++k)
+            {
+                const vec2 p = (*thread)(x[k]);
+                y[k * 2 + 0] = p.x;
+                y[k * 2 + 1] = p.y;
+            }
+        }
+        Py_END_ALLOW_THREADS
+
+        PyBuffer_Release(&in);
+        return NewArray(0, out, y, "d", sizeof(double), Py_ssize_t(n), 2, false);
+    }
+
+
+    PyObject* KnotMesh(PyObject* obj, PyObject*)
+    {
+        KnotObject* self = reinterpret_cast<KnotObject*>(obj);
+
+        Arrays* arrays = new Arrays;
+        Py_BEGIN_ALLOW_THREADS
+        Random random;
+        random.SetState(self->state);
+        Tessellate(*self->art, random, *arrays);
+        Py_END_ALLOW_THREADS
+
+        MeshObject* mesh = PyObject_New(MeshObject, &MeshType);
+        if (!mesh)
+        {
+            FreeArrays(*arrays);
+            delete arrays;
+            return 0;
+        }
+        mesh->arrays = arrays;
+        return reinterpret_cast<PyObject*>(mesh);
+    }
+
+
+    void MeshDealloc(PyObject* obj)
+    {
+        MeshObject* self = reinterpret_cast<MeshObject*>(obj);
+        FreeArrays(*self->arrays);
+        delete self->arrays;
+        PyObject_Free(self);
+    }
+
+
+    Py_ssize_t MeshLength(PyObject* obj)
+    {
+        return Py_ssize_t(reinterpret_cast<MeshObject*>(obj)->arrays->size());
+    }
+
+
+    PyObject* MeshVertices(PyObject* obj, PyObject* args)
+    {
+        MeshObject* self = reinterpret_cast<MeshObject*>(obj);
+        Py_ssize_t i;
+        if (!PyArg_ParseTuple(args, "n", &i))
+            return 0;
+        if (i < 0 || size_t(i) >= self->arrays->size())
+        {
+            PyErr_SetString(PyExc_IndexError, "no such thread");
+            return 0;
+        }
+
+        FloatArray& strip = *(*self->arrays)[size_t(i)];
+        return NewArray(obj, 0, strip.empty() ? 0 : &strip.front(), "f", sizeof(float),
+                Py_ssize_t(strip.size() / 6), 6, true);
+    }
+
+
+    PyObject* MakeStrokesFunction(PyObject*, PyObject* args, PyObject* kwargs)
+    {
+        unsigned int seed;
+        double aspect = 1.0;
+        LatticeParams lattice;
+        if (!ParseLattice(args, kwargs, seed, aspect, lattice))
+            return 0;
+
+        StrokeList strokes;
+        Random random(seed);
+        Py_BEGIN_ALLOW_THREADS
+        strokes = MakeStrokes(random, aspect, lattice);
+        Py_END_ALLOW_THREADS
+
+        return NewStrokes(strokes, random.GetState());
+    }
+
+
+    PyObject* CreateThreadFunction(PyObject*, PyObject* args)
+    {
+        PyObject* obj;
+        if (!PyArg_ParseTuple(args, "O!", &StrokesType, &obj))
+            return 0;
+
+        StrokesObject* strokes = reinterpret_cast<StrokesObject*>(obj);
+        if (strokes->strokes->empty())
+        {
+            PyErr_SetString(PyExc_ValueError, "no strokes to thread");
+            return 0;
+        }
+
+        AutoArt art;
+        Py_BEGIN_ALLOW_THREADS
+        art = CreateThread(*strokes->strokes);
+        Py_END_ALLOW_THREADS
+
+        return NewKnot(art, strokes->state);
+    }
+
+
+    PyObject* MakeKnotFunction(PyObject*, PyObject* args, PyObject* kwargs)
+    {
+        unsigned int seed;
+        double aspect = 1.0;
+        LatticeParams lattice;
+        if (!ParseLattice(args, kwargs, seed, aspect, lattice))
+            return 0;
+
+        AutoArt art;
+        Random random(seed);
+        Py_BEGIN_ALLOW_THREADS
+        const StrokeList strokes = MakeStrokes(random, aspect, lattice);
+        if (!strokes.empty())
+            art = CreateThread(strokes);
+        Py_END_ALLOW_THREADS
+
+        if (!art.get())
+        {
+            PyErr_SetString(PyExc_ValueError, "the lattice has no strokes to thread");
+            return 0;
+        }
+        return NewKnot(art, random.GetState());
+    }
+
+
+    PyMethodDef StrokesMethods[] = {
+        {"array", StrokesArray, METH_NOARGS, "array() -> Array of (n, 5) float64: ax, ay, bx, by and type (0 cross, 1 bounce, 2 glance)."},
+        {0, 0, 0, 0}
+    };
+
+    PyMethodDef KnotMethods[] = {
+        {"params", KnotParams, METH_VARARGS, "params(thread) -> Array of (n,) float64, the spline parameter at each knot."},
+        {"points", KnotPoints, METH_VARARGS, "points(thread) -> Array of (n, 2) float64, the position of each knot."},
+        {"tangents", KnotTangents, METH_VARARGS, "tangents(thread) -> Array of (n, 2) float64, the tangent at each knot."},
+        {"depths", KnotDepths, METH_VARARGS, "depths(thread) -> Array of (n,) float64, 1 where the thread passes over at a knot, 0 under."},
+        {"evaluate", KnotEvaluate, METH_VARARGS,
+            "evaluate(thread, params) -> Array of (len(params), 2) float64.\n"
+            "Evaluates the thread at each of a float64 buffer of parameters. They wrap around, and are quickest in order.\n"
+            "Raises ValueError if any is NaN or infinite."},
+        {"mesh", KnotMesh, METH_NOARGS, "mesh() -> Mesh, the ribbons as the screensaver draws them, coloured the same."},
+        {0, 0, 0, 0}
+    };
+
+    PyMethodDef MeshMethods[] = {
+        {"vertices", MeshVertices, METH_VARARGS, "vertices(thread) -> Array of (n, 6) float32 x, y, z, r, g, b, a quad strip."},
+        {0, 0, 0, 0}
+    };
+
+    PyMethodDef ModuleMethods[] = {
+        {"make_strokes", (PyCFunction)(void(*)(void))MakeStrokesFunction, METH_VARARGS | METH_KEYWORDS,
+            "make_strokes(seed, aspect=1, density=0, bounce=1/15, glance=1/15, removal=0) -> Strokes\n"
+            "Makes the lattice of a knot aspect wide and 1 high. A density or removal of 0 picks one at random."},
+        {"create_thread", CreateThreadFunction, METH_VARARGS, "create_thread(strokes) -> Knot, threaded through the strokes."},
+        {"make_knot", (PyCFunction)(void(*)(void))MakeKnotFunction, METH_VARARGS | METH_KEYWORDS,
+            "make_knot(seed, aspect=1, density=0, bounce=1/15, glance=1/15, removal=0) -> Knot\n"
+            "Does make_strokes then create_thread, without the GIL the whole time."},
+        {0, 0, 0, 0}
+    };
+
+    PySequenceMethods StrokesSequence = {StrokesLength};
+    PySequenceMethods KnotSequence = {KnotLength};
+    PySequenceMethods MeshSequence = {MeshLength};
+
+    PyModuleDef Module = {PyModuleDef_HEAD_INIT, "celtic_knots", "Random Celtic knots.", -1, ModuleMethods};
+
+
+    ///Fills in the fields every type here shares.
+    bool ReadyType(PyObject* module, PyTypeObject& type, const char* name, const char* doc, Py_ssize_t size,
+            destructor dealloc, PySequenceMethods* sequence, PyMethodDef* methods)
+    {
+        type.tp_name = name;
+        type.tp_doc = doc;
+        type.tp_basicsize = size;
+        type.tp_dealloc = dealloc;
+        type.tp_as_sequence = sequence;
+        type.tp_methods = methods;
+        type.tp_flags = Py_TPFLAGS_DEFAULT;
+
+        if (PyType_Ready(&type) < 0)
+            return false;
+
+        Py_INCREF(&type);
+        if (PyModule_AddObject(module, std::strrchr(name, '.') + 1, reinterpret_cast<PyObject*>(&type)) < 0)
+        {
+            Py_DECREF(&type);
+            return false;
+        }
+        return true;
+    }
+
+}
+
+
+PyMODINIT_FUNC PyInit_celtic_knots()
+{
+    PyObject* module = PyModule_Create(&Module);
+    if (!module)
+        return 0;
+
+    ArrayType.tp_as_buffer = &ArrayBuffer;
+    ArrayType.tp_getset = ArrayGetSet;
+
+    if (!ReadyType(module, ArrayType, "celtic_knots.Array", "Numbers kept by a knot or mesh, read through the buffer protocol.",
+                sizeof(ArrayObject), ArrayDealloc, &ArraySequence, 0) ||
+            !ReadyType(module, StrokesType, "celtic_knots.Strokes", "The lattice lines a knot is threaded through.",
+                sizeof(StrokesObject), StrokesDealloc, &StrokesSequence, StrokesMethods) ||
+            !ReadyType(module, KnotType, "celtic_knots.Knot", "A knot's threads as splines. len() is the number of threads.",
+                sizeof(KnotObject), KnotDealloc, &KnotSequence, KnotMethods) ||
+            !ReadyType(module, MeshType, "celtic_knots.Mesh", "A knot's ribbons. len() is the number of threads.",
+                sizeof(MeshObject), MeshDealloc, &MeshSequence, MeshMethods))
+    {
+        Py_DECREF(module);
+        return 0;
+    }
+
+    return module;
+}
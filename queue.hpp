@@ -0,0 +1,138 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __QUEUE_HPP__
+#define __QUEUE_HPP__
+
+#include <atomic>
+#include <cstddef>
+
+namespace CKnot
+{
+
+    ///Fixed size lock-free queue, safe for any number of producers and consumers.
+    /**Dmitry Vyukov's bounded MPMC ring. Each cell carries a sequence number that tells a producer when the
+     * cell is free for its ticket and a consumer when it holds the value for its ticket, so the only shared
+     * writes are one compare and swap on each end's position. Neither call ever blocks or allocates; a full or
+     * empty queue just returns false and the caller decides how to wait.
+     * The capacity is rounded up to a power of two. T must be copyable; pointers are the usual choice.
+     */
+    template <typename T>
+    class BoundedQueue
+    {
+        public:
+            explicit BoundedQueue(size_t capacity)
+            {
+                size_t size = 2;
+                while (size < capacity)
+                    size *= 2;
+
+                mCells = new Cell[size];
+                mMask = size - 1;
+                for (size_t i = 0; i < size; ++i)
+                    mCells[i].sequence.store(i, std::memory_order_relaxed);
+
+                mEnqueue.store(0, std::memory_order_relaxed);
+                mDequeue.store(0, std::memory_order_relaxed);
+            }
+
+            ~BoundedQueue() {delete[] mCells;}
+
+            bool TryPush(const T& value) ///<Adds value at the back. Returns false if the queue is full.
+            {
+                Cell* cell;
+                size_t pos = mEnqueue.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    cell = &mCells[pos & mMask];
+                    const ptrdiff_t diff = ptrdiff_t(cell->sequence.load(std::memory_order_acquire)) - ptrdiff_t(pos);
+                    if (diff == 0)
+                    {
+                        if (mEnqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                            break;
+                    }
+                    else if (diff < 0)
+                        return false;
+                    else
+                        pos = mEnqueue.load(std::memory_order_relaxed);
+                }
+
+                cell->value = value;
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool TryPop(T& value) ///<Takes the value at the front. Returns false if the queue is empty.
+            {
+                Cell* cell;
+                size_t pos = mDequeue.load(std::memory_order_relaxed);
+                for (;;)
+                {
+                    cell = &mCells[pos & mMask];
+                    const ptrdiff_t diff = ptrdiff_t(cell->sequence.load(std::memory_order_acquire)) - ptrdiff_t(pos + 1);
+                    if (diff == 0)
+                    {
+                        if (mDequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                            break;
+                    }
+                    else if (diff < 0)
+                        return false;
+                    else
+                        pos = mDequeue.load(std::memory_order_relaxed);
+                }
+
+                value = cell->value;
+                cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+                return true;
+            }
+
+            size_t GetCapacity() const {return mMask + 1;}
+
+            ///Returns how many values are queued. Only a snapshot while other threads are pushing or popping.
+            size_t GetSize() const
+            {
+                const size_t dequeue = mDequeue.load(std::memory_order_relaxed);
+                const size_t enqueue = mEnqueue.load(std::memory_order_relaxed);
+                return enqueue > dequeue ? enqueue - dequeue : 0;
+            }
+
+        private:
+            BoundedQueue(const BoundedQueue&);
+            BoundedQueue& operator=(const BoundedQueue&);
+
+            struct Cell
+            {
+                std::atomic<size_t> sequence;
+                T value;
+            };
+
+            enum {CacheLine = 64};
+
+            Cell* mCells;
+            size_t mMask;
+
+            //Producers and consumers each get their own cache line.
+            char mPad0[CacheLine];
+            std::atomic<size_t> mEnqueue;
+            char mPad1[CacheLine];
+            std::atomic<size_t> mDequeue;
+            char mPad2[CacheLine];
+    };
+
+}
+
+#endif /*__QUEUE_HPP__*/
@@ -0,0 +1,230 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "raster.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace CKnot
+{
+
+    namespace
+    {
+        unsigned char ToByte(float c)
+        {
+            if (c <= 0.0f)
+                return 0;
+            if (c >= 1.0f)
+                return 255;
+            return (unsigned char)(c * 255.0f + 0.5f);
+        }
+    }
+
+
+    SoftRenderer::SoftRenderer()
+        :mWidth(0), mHeight(0), mScaleX(1), mOffsetX(0), mScaleY(1), mOffsetY(0), mFlowing(false)
+    {
+    }
+
+
+    void SoftRenderer::Begin(int width, int height, const float clear[3],
+            double left, double right, double bottom, double top)
+    {
+        mWidth = width;
+        mHeight = height;
+        mFlow = Flow();
+
+        mScaleX = width / (right - left);
+        mOffsetX = -left * mScaleX;
+        mScaleY = -height / (top - bottom);
+        mOffsetY = height - bottom * mScaleY;
+
+        const size_t pixels = size_t(width) * size_t(height);
+        mPixels.resize(pixels * 3);
+        mDepth.assign(pixels, 1.0f);
+
+        const unsigned char r = ToByte(clear[0]), g = ToByte(clear[1]), b = ToByte(clear[2]);
+        for (size_t i = 0; i < pixels; ++i)
+        {
+            mPixels[i * 3 + 0] = r;
+            mPixels[i * 3 + 1] = g;
+            mPixels[i * 3 + 2] = b;
+        }
+    }
+
+
+    SoftRenderer::Vertex SoftRenderer::Project(const float* v, float along) const
+    {
+        Vertex ret;
+        ret.x = float(mOffsetX + v[0] * mScaleX);
+        ret.y = float(mOffsetY + v[1] * mScaleY);
+        ret.z = -v[2]; //glOrtho(..., -1, 1) flips z.
+        ret.r = v[3];
+        ret.g = v[4];
+        ret.b = v[5];
+        ret.along = along;
+        return ret;
+    }
+
+
+    void SoftRenderer::DrawQuadStrip(const float* vertices, const float* along, size_t first, size_t count)
+    {
+        mFlowing = along && mFlow.depth > 0.0f;
+
+        //Each quad of the strip is two triangles.
+        for (size_t i = first; i + 3 < first + count; i += 2)
+        {
+            const Vertex v0 = Project(vertices + (i + 0) * 6, mFlowing ? along[i + 0] : 0.0f);
+            const Vertex v1 = Project(vertices + (i + 1) * 6, mFlowing ? along[i + 1] : 0.0f);
+            const Vertex v2 = Project(vertices + (i + 2) * 6, mFlowing ? along[i + 2] : 0.0f);
+            const Vertex v3 = Project(vertices + (i + 3) * 6, mFlowing ? along[i + 3] : 0.0f);
+
+            Triangle(v0, v1, v2);
+            Triangle(v1, v3, v2);
+        }
+
+        mFlowing = false;
+    }
+
+
+    void SoftRenderer::DrawLines(const float* vertices, size_t count)
+    {
+        for (size_t i = 0; i + 1 < count; i += 2)
+        {
+            const float* a = vertices + i * 5;
+            const float* b = vertices + (i + 1) * 5;
+
+            const double ax = mOffsetX + a[0] * mScaleX, ay = mOffsetY + a[1] * mScaleY;
+            const double bx = mOffsetX + b[0] * mScaleX, by = mOffsetY + b[1] * mScaleY;
+
+            const int steps = int(std::max(std::fabs(bx - ax), std::fabs(by - ay))) + 1;
+            for (int s = 0; s <= steps; ++s)
+            {
+                const double t = double(s) / steps;
+                Plot(int(ax + (bx - ax) * t), int(ay + (by - ay) * t), 0.0f,
+                        a[2] + (b[2] - a[2]) * t, a[3] + (b[3] - a[3]) * t, a[4] + (b[4] - a[4]) * t);
+            }
+        }
+    }
+
+
+    void SoftRenderer::DrawOverlay(const float* vertices, size_t count)
+    {
+        //Lines cover the pixels they start in but not the ones they end in, like GL's.
+        for (size_t i = 0; i + 1 < count; i += 2)
+        {
+            const float* a = vertices + i * 5;
+            const float* b = vertices + (i + 1) * 5;
+
+            const int steps = int(std::max(std::fabs(b[0] - a[0]), std::fabs(b[1] - a[1])));
+            for (int s = 0; s < steps; ++s)
+            {
+                const float t = float(s) / steps;
+                Plot(int(a[0] + (b[0] - a[0]) * t), int(a[1] + (b[1] - a[1]) * t), -1.0f,
+                        a[2] + (b[2] - a[2]) * t, a[3] + (b[3] - a[3]) * t, a[4] + (b[4] - a[4]) * t);
+            }
+        }
+    }
+
+
+    void SoftRenderer::Plot(int x, int y, float z, float r, float g, float b)
+    {
+        if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
+            return;
+
+        const size_t p = size_t(y) * mWidth + x;
+        if (z > mDepth[p])
+            return;
+
+        mDepth[p] = z;
+        mPixels[p * 3 + 0] = ToByte(r);
+        mPixels[p * 3 + 1] = ToByte(g);
+        mPixels[p * 3 + 2] = ToByte(b);
+    }
+
+
+    void SoftRenderer::Triangle(const Vertex& a, const Vertex& b, const Vertex& c)
+    {
+        //Edge functions, sampled at pixel centres.
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (area == 0.0f)
+            return;
+
+        const Vertex* v1 = &b;
+        const Vertex* v2 = &c;
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+        const Vertex& v0 = a;
+
+        const int minX = std::max(0, int(std::floor(std::min(v0.x, std::min(v1->x, v2->x)))));
+        const int maxX = std::min(mWidth - 1, int(std::ceil(std::max(v0.x, std::max(v1->x, v2->x)))));
+        const int minY = std::max(0, int(std::floor(std::min(v0.y, std::min(v1->y, v2->y)))));
+        const int maxY = std::min(mHeight - 1, int(std::ceil(std::max(v0.y, std::max(v1->y, v2->y)))));
+
+        if (minX > maxX || minY > maxY)
+            return;
+
+        const float inv = 1.0f / area;
+
+        for (int y = minY; y <= maxY; ++y)
+        {
+            const float py = y + 0.5f;
+            for (int x = minX; x <= maxX; ++x)
+            {
+                const float px = x + 0.5f;
+
+                const float w0 = (v2->x - v1->x) * (py - v1->y) - (v2->y - v1->y) * (px - v1->x);
+                const float w1 = (v0.x - v2->x) * (py - v2->y) - (v0.y - v2->y) * (px - v2->x);
+                const float w2 = (v1->x - v0.x) * (py - v0.y) - (v1->y - v0.y) * (px - v0.x);
+
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                    continue;
+
+                const float l0 = w0 * inv, l1 = w1 * inv, l2 = w2 * inv;
+
+                //The same bands GL samples from its flow texture, worked out per pixel.
+                const float shade = mFlowing ? mFlow.GetShade(mFlow.GetPhase(l0 * v0.along + l1 * v1->along + l2 * v2->along)) : 1.0f;
+
+                Plot(x, y,
+                        l0 * v0.z + l1 * v1->z + l2 * v2->z,
+                        (l0 * v0.r + l1 * v1->r + l2 * v2->r) * shade,
+                        (l0 * v0.g + l1 * v1->g + l2 * v2->g) * shade,
+                        (l0 * v0.b + l1 * v1->b + l2 * v2->b) * shade);
+            }
+        }
+    }
+
+
+    bool SoftRenderer::WritePPM(const char* path) const
+    {
+        FILE* f = std::fopen(path, "wb");
+        if (!f)
+            return false;
+
+        std::fprintf(f, "P6\n%d %d\n255\n", mWidth, mHeight);
+        const bool ok = std::fwrite(GetPixels(), 3, size_t(mWidth) * mHeight, f) == size_t(mWidth) * mHeight;
+        std::fclose(f);
+
+        return ok;
+    }
+
+}
@@ -0,0 +1,73 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RASTER_HPP__
+#define __RASTER_HPP__
+
+#include <vector>
+#include "render.hpp"
+
+namespace CKnot
+{
+
+    ///Draws into memory on the CPU, for machines with no display or GL.
+    /**Pixels are 8 bit RGB, rows from top to bottom.
+     */
+    class SoftRenderer : public Renderer
+    {
+        public:
+            SoftRenderer();
+
+            virtual void Begin(int width, int height, const float clear[3],
+                    double left, double right, double bottom, double top);
+            virtual void SetFlow(const Flow& flow) {mFlow = flow;}
+            virtual void DrawQuadStrip(const float* vertices, const float* along, size_t first, size_t count);
+            virtual void DrawLines(const float* vertices, size_t count);
+            virtual void DrawOverlay(const float* vertices, size_t count);
+            virtual void End(){}
+
+            int GetWidth() const {return mWidth;}
+            int GetHeight() const {return mHeight;}
+            const unsigned char* GetPixels() const {return mPixels.empty() ? 0 : &mPixels.front();}
+
+            bool WritePPM(const char* path) const; ///<Saves the last frame as a binary PPM.
+
+        private:
+            struct Vertex
+            {
+                float x, y, z; ///<Pixel position and depth.
+                float r, g, b;
+                float along;
+            };
+
+            Vertex Project(const float* v, float along) const;
+            void Triangle(const Vertex& a, const Vertex& b, const Vertex& c);
+            void Plot(int x, int y, float z, float r, float g, float b);
+
+            int mWidth, mHeight;
+            double mScaleX, mOffsetX, mScaleY, mOffsetY; ///<Maps art space to pixels.
+
+            Flow mFlow;
+            bool mFlowing; ///<Whether the triangles being drawn are shaded by mFlow.
+
+            std::vector<unsigned char> mPixels;
+            std::vector<float> mDepth;
+    };
+
+}
+
+#endif /*__RASTER_HPP__*/
@@ -0,0 +1,99 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RENDER_HPP__
+#define __RENDER_HPP__
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace CKnot
+{
+
+    ///Bright bands that travel along the ribbons.
+    /**Strips drawn with an along coordinate, the distance in art units along their thread, are darkened by
+     * GetShade. Moving offset moves the bands along every thread without touching a vertex.
+     */
+    struct Flow
+    {
+        float period; ///<Art units from one band to the next.
+        float band; ///<Share of each period that is lit, from 0 to 1.
+        float depth; ///<How much darker the rest is, 0 for no bands.
+        float offset; ///<How far the bands have travelled, in art units.
+
+        Flow():period(.25f), band(.35f), depth(0.0f), offset(0.0f){}
+
+        ///Returns how far from the start of a period along falls, from 0 to 1.
+        double GetPhase(double along) const
+        {
+            const double u = (along - offset) / period;
+            return u - std::floor(u);
+        }
+
+        ///Returns what a colour is scaled by at a phase. Band edges blur over a twentieth of a period.
+        float GetShade(double phase) const
+        {
+            const double Edge = 0.05;
+            const double lit = (band * 0.5 - std::fabs(phase - 0.5)) / Edge + 0.5;
+            return float(1.0 - depth * (1.0 - std::min(std::max(lit, 0.0), 1.0)));
+        }
+    };
+
+
+    ///Something the engine can draw a frame on.
+    /**The vertex formats match what the engine builds: quad strips are x, y, z, r, g, b
+     * and lines are x, y, r, g, b, all floats. Depth follows GL with glOrtho(..., -1, 1) and
+     * GL_LEQUAL, so the vertex with the larger z wins.
+     * Quad strips may also come with one along coordinate per vertex, which the flow set for the frame shades by.
+     */
+    class Renderer
+    {
+        public:
+            virtual ~Renderer(){}
+
+            ///Starts a frame of width by height pixels, clears it, and maps left..right, top..bottom onto it.
+            virtual void Begin(int width, int height, const float clear[3],
+                    double left, double right, double bottom, double top) = 0;
+
+            ///Sets the bands strips with along coordinates are drawn with, until the next Begin turns them off.
+            virtual void SetFlow(const Flow& flow) = 0;
+
+            virtual void DrawQuadStrip(const float* vertices, const float* along, size_t first, size_t count) = 0; ///<Along may be null.
+            virtual void DrawLines(const float* vertices, size_t count) = 0;
+
+            ///Draws lines like DrawLines, but in pixels from the top left corner and over everything else.
+            virtual void DrawOverlay(const float* vertices, size_t count) = 0;
+
+            virtual void End() = 0;
+    };
+
+
+    ///What went into a frame.
+    struct RenderStats
+    {
+        size_t vertices;
+        size_t drawCalls;
+        size_t threads;
+        size_t culled; ///<Threads skipped as out of view.
+
+        RenderStats():vertices(0), drawCalls(0), threads(0), culled(0){}
+    };
+
+}
+
+#endif /*__RENDER_HPP__*/
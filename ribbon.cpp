@@ -0,0 +1,321 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ribbon.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CKNOT_RIBBON_X86
+#include <immintrin.h>
+#endif
+
+namespace CKnot
+{
+    namespace Ribbon
+    {
+
+        namespace
+        {
+            typedef void (*ExtrudeFunc)(const float*, const float*, const float*, const float*, size_t, float, float*);
+            typedef void (*PlaceFunc)(const float*, size_t, const Placement&, float*);
+
+            void ExtrudeScalar(const float* px, const float* py, const float* tx, const float* ty, size_t n,
+                    float halfWidth, float* edges)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const float scale = halfWidth / std::sqrt(tx[i] * tx[i] + ty[i] * ty[i]);
+                    const float nx = ty[i] * scale;
+                    const float ny = -tx[i] * scale;
+
+                    edges[i * 4 + 0] = px[i] + nx;
+                    edges[i * 4 + 1] = py[i] + ny;
+                    edges[i * 4 + 2] = px[i] - nx;
+                    edges[i * 4 + 3] = py[i] - ny;
+                }
+            }
+
+            //Every path adds up x' = (x + ex * c) + ey * -s and y' = (y + ey * c) + ex * s, in that order,
+            //so they all give the same bits.
+            void PlaceScalar(const float* edges, size_t n, const Placement& p, float* out)
+            {
+                const float ns = -p.s;
+
+                for (size_t i = 0; i < n; ++i, edges += 4, out += 12)
+                {
+                    out[0] = (p.x + edges[0] * p.c) + edges[1] * ns;
+                    out[1] = (p.y + edges[1] * p.c) + edges[0] * p.s;
+                    out[2] = p.z;
+                    out[3] = p.start[0];
+                    out[4] = p.start[1];
+                    out[5] = p.start[2];
+
+                    out[6] = (p.x + edges[2] * p.c) + edges[3] * ns;
+                    out[7] = (p.y + edges[3] * p.c) + edges[2] * p.s;
+                    out[8] = p.z;
+                    out[9] = p.end[0];
+                    out[10] = p.end[1];
+                    out[11] = p.end[2];
+                }
+            }
+
+#ifdef CKNOT_RIBBON_X86
+            ///Reciprocal square root, the CPU's estimate sharpened by a Newton step to about 23 bits.
+            __attribute__((target("sse2"))) inline __m128 RSqrt(__m128 x)
+            {
+                const __m128 r = _mm_rsqrt_ps(x);
+                const __m128 half = _mm_set1_ps(0.5f), three = _mm_set1_ps(3.0f);
+                return _mm_mul_ps(_mm_mul_ps(half, r), _mm_sub_ps(three, _mm_mul_ps(_mm_mul_ps(x, r), r)));
+            }
+
+            __attribute__((target("sse2")))
+            void ExtrudeSSE(const float* px, const float* py, const float* tx, const float* ty, size_t n,
+                    float halfWidth, float* edges)
+            {
+                const __m128 hw = _mm_set1_ps(halfWidth);
+
+                size_t i = 0;
+                for (; i + 4 <= n; i += 4)
+                {
+                    const __m128 x = _mm_loadu_ps(px + i), y = _mm_loadu_ps(py + i);
+                    const __m128 dx = _mm_loadu_ps(tx + i), dy = _mm_loadu_ps(ty + i);
+
+                    const __m128 scale = _mm_mul_ps(hw, RSqrt(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+                    const __m128 nx = _mm_mul_ps(dy, scale);
+                    const __m128 ny = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(dx, scale));
+
+                    //Four lanes of left x, left y, right x, right y, transposed into four samples.
+                    __m128 lx = _mm_add_ps(x, nx), ly = _mm_add_ps(y, ny);
+                    __m128 rx = _mm_sub_ps(x, nx), ry = _mm_sub_ps(y, ny);
+                    _MM_TRANSPOSE4_PS(lx, ly, rx, ry);
+
+                    _mm_storeu_ps(edges + i * 4 + 0, lx);
+                    _mm_storeu_ps(edges + i * 4 + 4, ly);
+                    _mm_storeu_ps(edges + i * 4 + 8, rx);
+                    _mm_storeu_ps(edges + i * 4 + 12, ry);
+                }
+
+                ExtrudeScalar(px + i, py + i, tx + i, ty + i, n - i, halfWidth, edges + i * 4);
+            }
+
+            //A sample of edges is one vector of left x, y and right x, y, so one rotation covers both edges:
+            //(origin + e * c) + swapped(e) * (-s, s, -s, s). Then it is shuffled in with the z and colours.
+            __attribute__((target("sse2")))
+            void PlaceSSE(const float* edges, size_t n, const Placement& p, float* out)
+            {
+                const __m128 origin = _mm_setr_ps(p.x, p.y, p.x, p.y);
+                const __m128 c = _mm_set1_ps(p.c);
+                const __m128 s = _mm_setr_ps(-p.s, p.s, -p.s, p.s);
+
+                const __m128 zStart = _mm_setr_ps(p.z, p.start[0], p.z, p.start[0]);
+                const __m128 startGB = _mm_setr_ps(p.start[1], p.start[2], p.start[1], p.start[2]);
+                const __m128 tail = _mm_setr_ps(p.z, p.end[0], p.end[1], p.end[2]);
+
+                for (size_t i = 0; i < n; ++i, edges += 4, out += 12)
+                {
+                    const __m128 e = _mm_loadu_ps(edges);
+                    const __m128 swapped = _mm_shuffle_ps(e, e, _MM_SHUFFLE(2, 3, 0, 1));
+                    const __m128 v = _mm_add_ps(_mm_add_ps(origin, _mm_mul_ps(e, c)), _mm_mul_ps(swapped, s));
+
+                    _mm_storeu_ps(out + 0, _mm_shuffle_ps(v, zStart, _MM_SHUFFLE(1, 0, 1, 0))); //lx ly z r
+                    _mm_storeu_ps(out + 4, _mm_shuffle_ps(startGB, v, _MM_SHUFFLE(3, 2, 1, 0))); //g b rx ry
+                    _mm_storeu_ps(out + 8, tail); //z r g b
+                }
+            }
+
+            __attribute__((target("avx2")))
+            void ExtrudeAVX2(const float* px, const float* py, const float* tx, const float* ty, size_t n,
+                    float halfWidth, float* edges)
+            {
+                const __m256 hw = _mm256_set1_ps(halfWidth);
+                const __m256 half = _mm256_set1_ps(0.5f), three = _mm256_set1_ps(3.0f);
+
+                size_t i = 0;
+                for (; i + 8 <= n; i += 8)
+                {
+                    const __m256 x = _mm256_loadu_ps(px + i), y = _mm256_loadu_ps(py + i);
+                    const __m256 dx = _mm256_loadu_ps(tx + i), dy = _mm256_loadu_ps(ty + i);
+
+                    const __m256 len2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+                    const __m256 r = _mm256_rsqrt_ps(len2);
+                    const __m256 rsqrt = _mm256_mul_ps(_mm256_mul_ps(half, r),
+                            _mm256_sub_ps(three, _mm256_mul_ps(_mm256_mul_ps(len2, r), r)));
+
+                    const __m256 scale = _mm256_mul_ps(hw, rsqrt);
+                    const __m256 nx = _mm256_mul_ps(dy, scale);
+                    const __m256 ny = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_mul_ps(dx, scale));
+
+                    const __m256 lx = _mm256_add_ps(x, nx), ly = _mm256_add_ps(y, ny);
+                    const __m256 rx = _mm256_sub_ps(x, nx), ry = _mm256_sub_ps(y, ny);
+
+                    //Transpose each 128 bit half as four samples, then write the low halves before the high ones.
+                    const __m256 t0 = _mm256_unpacklo_ps(lx, ly), t1 = _mm256_unpackhi_ps(lx, ly);
+                    const __m256 t2 = _mm256_unpacklo_ps(rx, ry), t3 = _mm256_unpackhi_ps(rx, ry);
+                    const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+                    const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+                    const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+                    const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+                    _mm256_storeu_ps(edges + i * 4 + 0, _mm256_permute2f128_ps(s0, s1, 0x20));
+                    _mm256_storeu_ps(edges + i * 4 + 8, _mm256_permute2f128_ps(s2, s3, 0x20));
+                    _mm256_storeu_ps(edges + i * 4 + 16, _mm256_permute2f128_ps(s0, s1, 0x31));
+                    _mm256_storeu_ps(edges + i * 4 + 24, _mm256_permute2f128_ps(s2, s3, 0x31));
+                }
+
+                ExtrudeScalar(px + i, py + i, tx + i, ty + i, n - i, halfWidth, edges + i * 4);
+            }
+
+            //Two samples at a time, one per 128 bit half, written out as three 256 bit stores.
+            __attribute__((target("avx2")))
+            void PlaceAVX2(const float* edges, size_t n, const Placement& p, float* out)
+            {
+                const __m256 origin = _mm256_setr_ps(p.x, p.y, p.x, p.y, p.x, p.y, p.x, p.y);
+                const __m256 c = _mm256_set1_ps(p.c);
+                const __m256 s = _mm256_setr_ps(-p.s, p.s, -p.s, p.s, -p.s, p.s, -p.s, p.s);
+
+                const __m256 zStart = _mm256_setr_ps(p.z, p.start[0], p.z, p.start[0], p.z, p.start[0], p.z, p.start[0]);
+                const __m256 startGB = _mm256_setr_ps(p.start[1], p.start[2], p.start[1], p.start[2],
+                        p.start[1], p.start[2], p.start[1], p.start[2]);
+                const __m256 tail = _mm256_setr_ps(p.z, p.end[0], p.end[1], p.end[2], p.z, p.end[0], p.end[1], p.end[2]);
+
+                size_t i = 0;
+                for (; i + 2 <= n; i += 2, edges += 8, out += 24)
+                {
+                    const __m256 e = _mm256_loadu_ps(edges);
+                    const __m256 swapped = _mm256_permute_ps(e, _MM_SHUFFLE(2, 3, 0, 1));
+                    const __m256 v = _mm256_add_ps(_mm256_add_ps(origin, _mm256_mul_ps(e, c)), _mm256_mul_ps(swapped, s));
+
+                    const __m256 a = _mm256_shuffle_ps(v, zStart, _MM_SHUFFLE(1, 0, 1, 0)); //lx ly z r, for each sample
+                    const __m256 b = _mm256_shuffle_ps(startGB, v, _MM_SHUFFLE(3, 2, 1, 0)); //g b rx ry
+
+                    _mm256_storeu_ps(out + 0, _mm256_permute2f128_ps(a, b, 0x20));
+                    _mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(tail, a, 0x30));
+                    _mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(b, tail, 0x31));
+                }
+
+                //The odd sample out, done here rather than in PlaceSSE to keep to VEX instructions.
+                if (i < n)
+                {
+                    const __m128 e = _mm_loadu_ps(edges);
+                    const __m128 swapped = _mm_shuffle_ps(e, e, _MM_SHUFFLE(2, 3, 0, 1));
+                    const __m128 v = _mm_add_ps(_mm_add_ps(_mm256_castps256_ps128(origin), _mm_mul_ps(e, _mm256_castps256_ps128(c))),
+                            _mm_mul_ps(swapped, _mm256_castps256_ps128(s)));
+
+                    _mm_storeu_ps(out + 0, _mm_shuffle_ps(v, _mm256_castps256_ps128(zStart), _MM_SHUFFLE(1, 0, 1, 0)));
+                    _mm_storeu_ps(out + 4, _mm_shuffle_ps(_mm256_castps256_ps128(startGB), v, _MM_SHUFFLE(3, 2, 1, 0)));
+                    _mm_storeu_ps(out + 8, _mm256_castps256_ps128(tail));
+                }
+            }
+#endif
+
+            struct Kernels
+            {
+                Path path;
+                ExtrudeFunc extrude;
+                PlaceFunc place;
+            };
+
+            bool Supported(Path path)
+            {
+#ifdef CKNOT_RIBBON_X86
+                switch (path)
+                {
+                    case Scalar: return true;
+                    case SSE: return __builtin_cpu_supports("sse2");
+                    case AVX2: return __builtin_cpu_supports("avx2");
+                }
+                return false;
+#else
+                return path == Scalar;
+#endif
+            }
+
+            Kernels Make(Path path)
+            {
+                Kernels k = {Scalar, ExtrudeScalar, PlaceScalar};
+#ifdef CKNOT_RIBBON_X86
+                if (path == SSE)
+                {
+                    k.path = SSE;
+                    k.extrude = ExtrudeSSE;
+                    k.place = PlaceSSE;
+                }
+                else if (path == AVX2)
+                {
+                    k.path = AVX2;
+                    k.extrude = ExtrudeAVX2;
+                    k.place = PlaceAVX2;
+                }
+#endif
+                return k;
+            }
+
+            Kernels& GetKernels()
+            {
+                static Kernels k = Make(Supported(AVX2) ? AVX2 : Supported(SSE) ? SSE : Scalar);
+                return k;
+            }
+        }
+
+
+        void Extrude(const float* px, const float* py, const float* tx, const float* ty, size_t n,
+                float halfWidth, float* edges)
+        {
+            GetKernels().extrude(px, py, tx, ty, n, halfWidth, edges);
+        }
+
+
+        void Place(const float* edges, size_t n, const Placement& p, float* out)
+        {
+            GetKernels().place(edges, n, p, out);
+        }
+
+
+        Path GetPath()
+        {
+            return GetKernels().path;
+        }
+
+
+        bool SetPath(Path path)
+        {
+            if (!Supported(path))
+                return false;
+            GetKernels() = Make(path);
+            return true;
+        }
+
+
+        const char* GetName(Path path)
+        {
+            static const char* const names[] = {"scalar", "sse", "avx2"};
+            return names[path];
+        }
+
+
+        bool SetPath(const char* name)
+        {
+            for (int i = Scalar; i <= AVX2; ++i)
+                if (!std::strcmp(name, GetName(Path(i))))
+                    return SetPath(Path(i));
+            return false;
+        }
+
+    }
+}
@@ -0,0 +1,64 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RIBBON_HPP__
+#define __RIBBON_HPP__
+
+#include <cstddef>
+
+namespace CKnot
+{
+
+    ///Kernels that turn thread samples into ribbon vertices.
+    /**On x86 each has SSE and AVX2 versions, and the best one the CPU runs is picked the first time one is called.
+     * Place gives the same bits on every path. Extrude uses the CPU's approximate reciprocal square root, so its
+     * last bits can differ between paths and between CPU makers, far below what shows on screen.
+     */
+    namespace Ribbon
+    {
+        enum Path {Scalar, SSE, AVX2};
+
+        ///Offsets samples by halfWidth either side of the thread.
+        /**Positions and tangents come in as separate x and y arrays. For each sample, edges gets x, y of the
+         * left edge then x, y of the right edge. The left edge is on the right hand of the tangent, as glOrtho
+         * with y down sees it.
+         */
+        void Extrude(const float* px, const float* py, const float* tx, const float* ty, size_t n,
+                float halfWidth, float* edges);
+
+        ///Where Place puts a run of edges, and what it gives them.
+        struct Placement
+        {
+            float x, y; ///<Where the edges' origin goes.
+            float c, s; ///<Cosine and sine of their rotation.
+            float z;
+            const float* start; ///<Colour of the left edge.
+            const float* end; ///<Colour of the right edge.
+        };
+
+        ///Rotates and moves n samples of edges, writing them out as quad strip vertices, 12 floats a sample.
+        void Place(const float* edges, size_t n, const Placement& p, float* out);
+
+        Path GetPath(); ///<Returns the path in use.
+        bool SetPath(Path path); ///<Uses a path, if the CPU can run it. Returns false and changes nothing if not.
+        const char* GetName(Path path);
+        bool SetPath(const char* name); ///<Uses a path by its name, as GetName gives it. Returns false if there is none or the CPU can't run it.
+    }
+
+}
+
+#endif /*__RIBBON_HPP__*/
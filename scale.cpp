@@ -0,0 +1,531 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//Generation pipeline scaling benchmark. Times each phase of making a knot over a
+//sweep of lattice sizes, stroke type ratios and removal ratios, and fits how each
+//phase grows with the number of strokes. Needs CKNOT_STATS. With CKNOT_PERF it also
+//reports instructions per cycle and cache and branch misses per item in each phase.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lattice.hpp"
+#include "mesh.hpp"
+#include "pick.hpp"
+#include "ribbon.hpp"
+
+#ifndef CKNOT_STATS
+#error celtic_scale needs CKNOT_STATS defined.
+#endif
+
+namespace
+{
+    using namespace CKnot;
+
+    struct Result
+    {
+        size_t lattice; ///<Junctions along each side.
+        size_t strokes; ///<Strokes left after removal.
+        size_t threads;
+        double times[PhaseCount]; ///<Fastest time of each phase over the repeats.
+        Stats stats; ///<Everything from the last repeat.
+    };
+
+    ///Makes one knot on an n by n lattice, timing each phase.
+    Result Run(size_t n, const LatticeParams& base, unsigned int seed, int reps, Pool* pool)
+    {
+        Result r;
+        r.lattice = n;
+        std::fill(r.times, r.times + PhaseCount, 1e300);
+
+        LatticeParams params = base;
+        params.junctionsPer = double(n);
+
+        for (int rep = 0; rep < reps; ++rep)
+        {
+            Random random(seed);
+            Stats stats;
+
+            StrokeList sl;
+            {
+                CKNOT_PHASE(&stats, PhaseStrokes);
+                sl = CreateSquareStrokes(random, 1.0, 1.0, params);
+            }
+            {
+                CKNOT_PHASE(&stats, PhaseRemove);
+                sl = RemoveStrokes(random, sl, params);
+            }
+
+            AutoArt art = CreateThread(sl, &stats);
+
+            Arrays arrays;
+            Tessellate(*art, random, arrays, &stats, pool);
+            FreeArrays(arrays);
+
+            for (int i = 0; i < PhaseCount; ++i)
+                r.times[i] = std::min(r.times[i], stats.times[i]);
+
+            r.strokes = sl.size();
+            r.threads = art->GetThreadCount();
+            r.stats = stats;
+        }
+
+        return r;
+    }
+
+    double Total(const Result& r)
+    {
+        double total = 0.0;
+        for (int i = 0; i < PhaseCount; ++i)
+            total += r.times[i];
+        return total;
+    }
+
+    void PrintHeader(const char* first, const char* unit = "ms")
+    {
+        std::printf("%-14s %9s %7s", first, "strokes", "threads");
+        for (int i = 0; i < PhaseCount; ++i)
+            std::printf(" %10s", Stats::GetName(Phase(i)));
+        std::printf("   (%s)\n", unit);
+    }
+
+    void PrintRow(const char* first, const Result& r)
+    {
+        std::printf("%-14s %9lu %7lu", first, (unsigned long)r.strokes, (unsigned long)r.threads);
+        for (int i = 0; i < PhaseCount; ++i)
+            std::printf(" %10.3f", r.times[i] * 1e3);
+        std::printf("\n");
+    }
+
+    void PrintAllocRow(const char* first, const Result& r)
+    {
+        std::printf("%-14s %9lu %7lu", first, (unsigned long)r.strokes, (unsigned long)r.threads);
+        for (int i = 0; i < PhaseCount; ++i)
+            std::printf(" %5.1f/%-4.0f", double(r.stats.allocs[i]) / r.strokes, r.stats.peakBytes[i] / 1024.0);
+        std::printf("\n");
+    }
+
+    ///Returns what a phase's per-item hardware counts are divided by: strokes while making the lattice,
+    ///nodes while building and walking the graph and splines, and vertices while meshing.
+    double Items(const Stats& stats, int phase, const char** name)
+    {
+        switch (phase)
+        {
+            case PhaseStrokes:
+            case PhaseRemove:
+                *name = "stroke";
+                return double(stats.counts[CountStrokes]);
+            case PhaseMesh:
+                *name = "vertex";
+                return double(stats.counts[CountVertices]);
+            default:
+                *name = "node";
+                return double(stats.counts[CountNodes]);
+        }
+    }
+
+    void PrintPerfRow(const char* first, const Result& r)
+    {
+        std::printf("%-14s %9lu %7lu", first, (unsigned long)r.strokes, (unsigned long)r.threads);
+        for (int i = 0; i < PhaseCount; ++i)
+        {
+            const char* unit;
+            const double items = std::max(1.0, Items(r.stats, i, &unit));
+            std::printf(" %4.2f/%5.2f", r.stats.GetIPC(Phase(i)), r.stats.perf[i][PerfCacheMisses] / items);
+        }
+        std::printf("\n");
+    }
+
+    ///Least squares slope of log(time) against log(strokes), ignoring runs too quick to time.
+    double Exponent(const std::vector<Result>& results, int phase, size_t* used)
+    {
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        size_t n = 0;
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+            if (r.strokes < 2 || r.times[phase] < 1e-4)
+                continue;
+
+            const double x = std::log(double(r.strokes));
+            const double y = std::log(r.times[phase]);
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+            ++n;
+        }
+
+        *used = n;
+        if (n < 2)
+            return 0.0;
+
+        return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    }
+
+    ///Returns the distance from a point to the nearest of samples dense samples along each segment of art near it.
+    /**Goes through the splines rather than PickIndex, so it checks Measure rather than repeating it. Only
+     * segments whose boxes are within limit of the point are sampled.
+     */
+    double FindByDenseScan(const Art& art, const std::vector<Box>& boxes, double x, double y, double limit, int samples)
+    {
+        double best = limit * limit;
+        size_t box = 0;
+        for (size_t i = 0; i < art.GetThreadCount(); ++i)
+        {
+            const Art::Thread& thread = *art.GetThread(i);
+            for (size_t k = 0; k + 1 < thread.GetKnotCount(); ++k, ++box)
+            {
+                const Box& b = boxes[box];
+                const double dx = x < b.min[0] ? b.min[0] - x : (x > b.max[0] ? x - b.max[0] : 0.0);
+                const double dy = y < b.min[1] ? b.min[1] - y : (y > b.max[1] ? y - b.max[1] : 0.0);
+                if (dx * dx + dy * dy > best)
+                    continue;
+
+                const double from = thread.GetKnotX(k), to = thread.GetKnotX(k + 1);
+                for (int j = 0; j <= samples; ++j)
+                {
+                    const vec2 p = thread(from + (to - from) * j / samples);
+                    const double d = (p.x - x) * (p.x - x) + (p.y - y) * (p.y - y);
+                    if (d < best)
+                        best = d;
+                }
+            }
+        }
+        return std::sqrt(best);
+    }
+
+    ///How the splines found their segments while art was evaluated in one order.
+    struct Lookups
+    {
+        std::string lattice;
+        const char* order;
+        Spline::LookupStats stats;
+    };
+
+    ///Evaluates every thread of art at samples points a segment, first to last or last to first.
+    void Walk(const Art& art, int samples, bool reverse)
+    {
+        for (size_t i = 0; i < art.GetThreadCount(); ++i)
+        {
+            const Art::Thread& thread = *art.GetThread(i);
+            const size_t n = (thread.GetKnotCount() - 1) * samples;
+            const double from = thread.GetKnotX(0), to = thread.GetKnotX(thread.GetKnotCount() - 1);
+            for (size_t j = 0; j <= n; ++j)
+                thread(from + (to - from) * double(reverse ? n - j : j) / n);
+        }
+    }
+
+    void PrintLookups(const Lookups& l)
+    {
+        const Spline::LookupStats& s = l.stats;
+        size_t far = 0;
+        for (int i = 4; i < Spline::LookupStats::WalkBuckets; ++i)
+            far += s.walks[i];
+
+        const double calls = double(std::max<size_t>(s.calls, 1));
+        std::printf("%-10s %-8s %11lu %11.2f %8.1f%% %8.1f%% %9lu %11lu\n", l.lattice.c_str(), l.order, (unsigned long)s.calls,
+                s.steps / calls, s.walks[0] * 100.0 / calls, far * 100.0 / calls, (unsigned long)s.wraps, (unsigned long)s.mods);
+    }
+
+    ///Times picking on a knot from an n by n lattice, against measuring every segment, and counts how the splines
+    ///found their segments as the checks and a few other orders evaluated them.
+    void RunPicks(size_t n, const LatticeParams& base, unsigned int seed, size_t picks, std::vector<Lookups>& lookups)
+    {
+        LatticeParams params = base;
+        params.junctionsPer = double(n);
+
+        Random random(seed);
+        StrokeList sl = CreateSquareStrokes(random, 1.0, 1.0, params);
+        sl = RemoveStrokes(random, sl, params);
+        AutoArt art = CreateThread(sl);
+
+        PickIndex index;
+        double start = Stats::Now();
+        index.Build(*art);
+        const double build = Stats::Now() - start;
+
+        //Points over the whole knot and a little past its edges, each looking as far as it takes.
+        std::vector<double> points(picks * 2);
+        for (size_t i = 0; i < points.size(); ++i)
+            points[i] = random.Unit() * 1.2 - 0.1;
+
+        std::vector<Pick> found(picks);
+        start = Stats::Now();
+        for (size_t i = 0; i < picks; ++i)
+            index.Find(points[i * 2], points[i * 2 + 1], 1e9, found[i]);
+        const double find = (Stats::Now() - start) / picks;
+
+        //The scan is slow on big knots, so it checks a sample of the points.
+        const size_t scans = std::min(picks, std::max<size_t>(100, 10000000 / std::max<size_t>(index.GetSegmentCount(), 1)));
+        size_t agree = 0;
+        start = Stats::Now();
+        for (size_t i = 0; i < scans; ++i)
+        {
+            Pick p;
+            index.FindByScan(points[i * 2], points[i * 2 + 1], 1e9, p);
+            if (std::fabs(p.distance - found[i].distance) < 1e-9)
+                ++agree;
+        }
+        const double scan = (Stats::Now() - start) / scans;
+
+        //A dense sample of each nearby segment is never closer than the true nearest point, so a pick is only
+        //wrong if the sample beats it.
+        std::vector<Box> boxes;
+        for (size_t i = 0; i < art->GetThreadCount(); ++i)
+            for (size_t k = 0; k + 1 < art->GetThread(i)->GetKnotCount(); ++k)
+                boxes.push_back(GetSegmentBounds(*art->GetThread(i), k, 1e-6));
+
+        char name[32];
+        std::sprintf(name, "%lux%lu", (unsigned long)n, (unsigned long)n);
+        Lookups l;
+        l.lattice = name;
+
+        const size_t checks = std::min<size_t>(scans, 1000);
+        size_t exact = 0;
+        art->ClearLookupStats();
+        for (size_t i = 0; i < checks; ++i)
+            if (FindByDenseScan(*art, boxes, points[i * 2], points[i * 2 + 1], found[i].distance + 1e-3, 1024) >= found[i].distance - 1e-9)
+                ++exact;
+        l.order = "dense";
+        l.stats = art->GetLookupStats();
+        lookups.push_back(l);
+
+        //Each pick's place on its thread, in the random order the points came in.
+        art->ClearLookupStats();
+        for (size_t i = 0; i < picks; ++i)
+            (*art->GetThread(found[i].thread))(found[i].param);
+        l.order = "picked";
+        l.stats = art->GetLookupStats();
+        lookups.push_back(l);
+
+        //Along the threads each way, as a reveal draws them in or back out.
+        for (int reverse = 0; reverse < 2; ++reverse)
+        {
+            art->ClearLookupStats();
+            Walk(*art, 16, reverse != 0);
+            l.order = reverse ? "reverse" : "forward";
+            l.stats = art->GetLookupStats();
+            lookups.push_back(l);
+        }
+
+        std::printf("%-10s %9lu %9.2f %8.1f %10.2f %10.1f %8.0fx %6lu/%-6lu %5lu/%-5lu\n", name, (unsigned long)index.GetSegmentCount(),
+                build * 1e3, index.GetBytes() / 1024.0, find * 1e6, scan * 1e6, scan / find, (unsigned long)agree, (unsigned long)scans,
+                (unsigned long)exact, (unsigned long)checks);
+        std::fflush(stdout);
+    }
+
+    void Usage(const char* argv0)
+    {
+        std::fprintf(stderr,
+                "usage: %s [-min N] [-max N] [-ratio-size N] [-reps R] [-budget S] [-seed N] [-threads T] [-kernel K] [-picks N]\n"
+                "  -min N         smallest lattice side (default 4)\n"
+                "  -max N         largest lattice side, up to 2000 (default 512)\n"
+                "  -ratio-size N  lattice side for the ratio sweeps (default 64)\n"
+                "  -reps R        repeats per run, the fastest is kept (default 3)\n"
+                "  -budget S      stop growing the lattice once a run takes S seconds (default 30)\n"
+                "  -seed N        seed (default 1)\n"
+                "  -threads T     mesh on T threads, 0 for one per core (default 1)\n"
+                "  -kernel K      ribbon kernel: scalar, sse or avx2 (default the best the CPU has)\n"
+                "  -picks N       points to pick in the picking sweep (default 10000)\n",
+                argv0);
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    size_t minSize = 4, maxSize = 512, ratioSize = 64;
+    int reps = 3;
+    double budget = 30.0;
+    unsigned int seed = 1;
+    int threads = 1;
+    size_t picks = 10000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "-min") && i + 1 < argc)
+            minSize = std::strtoul(argv[++i], 0, 10);
+        else if (!std::strcmp(argv[i], "-max") && i + 1 < argc)
+            maxSize = std::strtoul(argv[++i], 0, 10);
+        else if (!std::strcmp(argv[i], "-ratio-size") && i + 1 < argc)
+            ratioSize = std::strtoul(argv[++i], 0, 10);
+        else if (!std::strcmp(argv[i], "-reps") && i + 1 < argc)
+            reps = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "-budget") && i + 1 < argc)
+            budget = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "-seed") && i + 1 < argc)
+            seed = (unsigned int)std::strtoul(argv[++i], 0, 0);
+        else if (!std::strcmp(argv[i], "-threads") && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "-picks") && i + 1 < argc)
+            picks = std::strtoul(argv[++i], 0, 10);
+        else if (!std::strcmp(argv[i], "-kernel") && i + 1 < argc)
+        {
+            if (!Ribbon::SetPath(argv[++i]))
+            {
+                std::fprintf(stderr, "%s: no %s kernel on this CPU\n", argv[0], argv[i]);
+                return 1;
+            }
+        }
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (minSize < 2 || maxSize < minSize || maxSize > 2000 || reps < 1 || threads < 0 || picks < 1)
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    Pool pool(threads);
+    Pool* meshPool = pool.GetThreadCount() > 1 ? &pool : 0;
+
+    //Fix the removal ratio so every size gets the same kind of lattice.
+    LatticeParams base;
+    base.removal = 0.1;
+
+    std::printf("lattice sweep (bounce %.3f, glance %.3f, removal %.3f, %lu threads, %s)\n", base.bounce, base.glance, base.removal,
+            (unsigned long)pool.GetThreadCount(), Ribbon::GetName(Ribbon::GetPath()));
+    PrintHeader("lattice");
+
+    std::vector<Result> results;
+    for (size_t n = minSize; n <= maxSize; n = (n * 2 > maxSize && n != maxSize) ? maxSize : n * 2)
+    {
+        //Big lattices take long enough that one run is plenty.
+        const Result r = Run(n, base, seed, n >= 256 ? 1 : reps, meshPool);
+        results.push_back(r);
+
+        char name[32];
+        std::sprintf(name, "%lux%lu", (unsigned long)n, (unsigned long)n);
+        PrintRow(name, r);
+        std::fflush(stdout);
+
+        if (Total(r) > budget)
+        {
+            std::printf("(stopping, %.1f s is over the %.1f s budget)\n", Total(r), budget);
+            break;
+        }
+
+        if (n == maxSize)
+            break;
+    }
+
+#ifdef CKNOT_ALLOC_STATS
+    std::printf("\nallocations per stroke / peak KiB\n");
+    PrintHeader("lattice", "allocs/KiB");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        char name[32];
+        std::sprintf(name, "%lux%lu", (unsigned long)results[i].lattice, (unsigned long)results[i].lattice);
+        PrintAllocRow(name, results[i]);
+    }
+#endif
+
+#ifdef CKNOT_PERF
+    if (!HasPerfCounter(PerfCycles))
+        std::printf("\n(no hardware counters, check /proc/sys/kernel/perf_event_paranoid)\n");
+    else
+    {
+        std::printf("\ninstructions per cycle / cache misses per item\n");
+        PrintHeader("lattice", "IPC/misses");
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            char name[32];
+            std::sprintf(name, "%lux%lu", (unsigned long)results[i].lattice, (unsigned long)results[i].lattice);
+            PrintPerfRow(name, results[i]);
+        }
+
+        //The biggest lattice says the most about whether each phase waits on memory.
+        const Stats& last = results.back().stats;
+        std::printf("\non %lux%lu\n", (unsigned long)results.back().lattice, (unsigned long)results.back().lattice);
+        std::printf("%-10s %6s %14s %14s %8s\n", "phase", "IPC", "cache misses", "branch misses", "per");
+        for (int i = 0; i < PhaseCount; ++i)
+        {
+            const char* unit;
+            const double items = std::max(1.0, Items(last, i, &unit));
+            std::printf("%-10s %6.2f %14.3f %14.3f %8s\n", Stats::GetName(Phase(i)), last.GetIPC(Phase(i)),
+                    last.perf[i][PerfCacheMisses] / items, last.perf[i][PerfBranchMisses] / items, unit);
+        }
+    }
+#endif
+
+    std::printf("\nempirical complexity, time ~ strokes^k\n");
+    for (int i = 0; i < PhaseCount; ++i)
+    {
+        size_t used = 0;
+        const double k = Exponent(results, i, &used);
+        if (used < 2)
+            std::printf("%-10s  (too fast to fit)\n", Stats::GetName(Phase(i)));
+        else
+            std::printf("%-10s  k = %.2f  (%lu sizes)%s\n", Stats::GetName(Phase(i)), k, (unsigned long)used,
+                    k > 1.5 ? "  <- superlinear" : "");
+    }
+
+    std::printf("\nstroke type sweep on %lux%lu\n", (unsigned long)ratioSize, (unsigned long)ratioSize);
+    PrintHeader("bounce/glance");
+    const double typeRatios[] = {0.0, 1.0 / 15.0, 0.2, 0.4};
+    for (size_t b = 0; b < sizeof(typeRatios) / sizeof(*typeRatios); ++b)
+    {
+        for (size_t g = 0; g < sizeof(typeRatios) / sizeof(*typeRatios); ++g)
+        {
+            LatticeParams params = base;
+            params.bounce = typeRatios[b];
+            params.glance = typeRatios[g];
+
+            char name[32];
+            std::sprintf(name, "%.2f/%.2f", params.bounce, params.glance);
+            PrintRow(name, Run(ratioSize, params, seed, reps, meshPool));
+        }
+    }
+
+    std::printf("\nremoval sweep on %lux%lu\n", (unsigned long)ratioSize, (unsigned long)ratioSize);
+    PrintHeader("removal");
+    const double removals[] = {0.01, 0.05, 0.1, 0.2, 0.33, 0.5};
+    for (size_t i = 0; i < sizeof(removals) / sizeof(*removals); ++i)
+    {
+        LatticeParams params = base;
+        params.removal = removals[i];
+
+        char name[32];
+        std::sprintf(name, "%.2f", params.removal);
+        PrintRow(name, Run(ratioSize, params, seed, reps, meshPool));
+    }
+
+    std::printf("\npicking, %lu points\n", (unsigned long)picks);
+    std::printf("%-10s %9s %9s %8s %10s %10s %9s %13s %11s\n", "lattice", "segments", "build ms", "KiB", "pick us", "scan us", "speedup", "agree", "dense");
+    std::vector<Lookups> lookups;
+    for (size_t n = 16; n <= std::min<size_t>(maxSize, 512); n *= 2)
+        RunPicks(n, base, seed, picks, lookups);
+
+    //Only counted when built with SPLINE_STATS.
+    std::printf("\nspline lookups\n");
+    std::printf("%-10s %-8s %11s %11s %9s %9s %9s %11s\n", "lattice", "order", "lookups", "mean steps", "cached", "8+ steps", "wraps", "mods");
+    for (size_t i = 0; i < lookups.size(); ++i)
+        PrintLookups(lookups[i]);
+
+    return 0;
+}
@@ -284,6 +284,54 @@ namespace Spline
     }
 
 
+    ///Counts how a spline found the segment for each x.
+    /**Splines only count if SPLINE_STATS is defined, otherwise these stay zero. Every object file
+     * that shares a spline must agree on SPLINE_STATS, since it changes the class layout.
+     */
+    struct LookupStats
+    {
+        enum {WalkBuckets = 8}; ///<Walks of 0, 1, 2-3, 4-7, 8-15, 16-31, 32-63 and 64 or more steps.
+
+        size_t calls; ///<Index lookups.
+        size_t steps; ///<Steps walked from the cached index, over all lookups.
+        size_t walks[WalkBuckets]; ///<Lookups by how far they walked. walks[0] found x at the cached index.
+        size_t wraps; ///<Times a walk looped past the first or last knot.
+        size_t mods; ///<Calls to Function::Mod to fold x into the spline's range.
+
+        LookupStats() {Clear();}
+
+        void Clear()
+        {
+            calls = steps = wraps = mods = 0;
+            for (int i = 0; i < WalkBuckets; ++i)
+                walks[i] = 0;
+        }
+
+        LookupStats& operator+=(const LookupStats& rhs)
+        {
+            calls += rhs.calls;
+            steps += rhs.steps;
+            wraps += rhs.wraps;
+            mods += rhs.mods;
+            for (int i = 0; i < WalkBuckets; ++i)
+                walks[i] += rhs.walks[i];
+            return *this;
+        }
+
+        ///Returns which walks entry a walk of this many steps goes in.
+        static int GetBucket(size_t steps)
+        {
+            int b = 0;
+            while (steps && b < WalkBuckets - 1)
+            {
+                steps >>= 1;
+                ++b;
+            }
+            return b;
+        }
+    };
+
+
     ///Interface for interpolation between several points.
     template <typename ST, typename FT = double>
         class Spline
@@ -299,7 +347,7 @@ namespace Spline
                  * \param copy If true xs and ys are copied, if false they are not (and the original data must remain valid for the life of the spline).
                  */
                 Spline(const FT* xs, const ST* ys, size_t n, bool loop, bool copy)
-                    :mN(n), mLoop(loop), mCopy(copy)
+                    :mN(n), mLoop(loop), mCopy(copy), mLastIndex(0)
                 {
                     assert(mN > 1);
 
@@ -343,6 +391,18 @@ namespace Spline
                 virtual ST Y(FT x) const = 0;
 
                 size_t GetKnotCount() const {return mN;}
+                FT GetKnotX(size_t index) const {return GetX(int(index));} ///<Returns the x of a knot. Index will loop around.
+                ST GetKnotY(size_t index) const {return GetY(int(index));} ///<Returns the y of a knot. Index will loop around.
+                const FT* GetKnotXs() const {return mXs;} ///<Returns the x of every knot, GetKnotCount of them.
+                const ST* GetKnotYs() const {return mYs;} ///<Returns the y of every knot, GetKnotCount of them.
+
+#ifdef SPLINE_STATS
+                const LookupStats& GetLookupStats() const {return mStats;} ///<Returns the lookups since construction or the last clear.
+                void ClearLookupStats() const {mStats.Clear();}
+#else
+                LookupStats GetLookupStats() const {return LookupStats();}
+                void ClearLookupStats() const {}
+#endif
 
             protected:
                 const size_t mN : 30; ///<Number of data points.
@@ -356,10 +416,18 @@ namespace Spline
 
                     //Convert x to be between mXs[0] and mXs[mN-1].
                     if (mLoop)
-                        x = Function::Mod(x, mXs[0], mXs[mN-1]);
+                        x = LoopInRange(x);
+
+#ifdef SPLINE_STATS
+                    size_t steps = 0;
+#endif
 
                     while (true)
                     {
+#ifdef SPLINE_STATS
+                        if (i < 0 || i >= int(mN))
+                            ++mStats.wraps;
+#endif
                         i = Function::Imod(i, mN);
 
                         const FT& current = GetX(i);
@@ -379,8 +447,17 @@ namespace Spline
                                 break;
                             --i;
                         }
+#ifdef SPLINE_STATS
+                        ++steps;
+#endif
                     }
 
+#ifdef SPLINE_STATS
+                    ++mStats.calls;
+                    mStats.steps += steps;
+                    ++mStats.walks[LookupStats::GetBucket(steps)];
+#endif
+
                     mLastIndex = i;
                     return mLastIndex;
                 }
@@ -422,12 +499,18 @@ namespace Spline
                 ///Loops x within the range of this spline.
                 FT LoopInRange(FT x) const
                 {
+#ifdef SPLINE_STATS
+                    ++mStats.mods;
+#endif
                     return Function::Mod(x, mXs[0], mXs[mN-1]);
                 }
 
 
             private:
                 mutable size_t mLastIndex; ///<Accelerates index lookup.
+#ifdef SPLINE_STATS
+                mutable LookupStats mStats;
+#endif
 
                 const FT *mXs;
                 const ST *mYs;
@@ -532,7 +615,7 @@ namespace Spline
             virtual ~Hermite()
             {
                 if (this->mCopy)
-                    delete mMs;
+                    delete[] mMs;
             }
 
             virtual ST Y(FT x) const
@@ -549,6 +632,9 @@ namespace Spline
                 return Function::Hermite<ST, FT>(m1, y1, y2, m2, t);
             }
 
+            ST GetKnotM(size_t index) const {return GetM(int(index));} ///<Returns the tangent at a knot. Index will loop around.
+            const ST* GetKnotMs() const {return mMs;} ///<Returns the tangent at every knot, GetKnotCount of them.
+
         protected:
                 ///Returns a m value. Index will loop around.
                 ST GetM(int index) const
@@ -0,0 +1,236 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+namespace CKnot
+{
+
+    void Stats::Clear()
+    {
+        for (int i = 0; i < PhaseCount; ++i)
+        {
+            times[i] = 0.0;
+            calls[i] = 0;
+            allocs[i] = 0;
+            allocBytes[i] = 0;
+            peakBytes[i] = 0;
+            for (int j = 0; j < PerfEventCount; ++j)
+                perf[i][j] = 0;
+        }
+
+        for (int i = 0; i < CountCount; ++i)
+            counts[i] = 0;
+    }
+
+
+    Stats& Stats::operator+=(const Stats& rhs)
+    {
+        for (int i = 0; i < PhaseCount; ++i)
+        {
+            times[i] += rhs.times[i];
+            calls[i] += rhs.calls[i];
+            allocs[i] += rhs.allocs[i];
+            allocBytes[i] += rhs.allocBytes[i];
+            peakBytes[i] = std::max(peakBytes[i], rhs.peakBytes[i]);
+            for (int j = 0; j < PerfEventCount; ++j)
+                perf[i][j] += rhs.perf[i][j];
+        }
+
+        for (int i = 0; i < CountCount; ++i)
+            counts[i] += rhs.counts[i];
+
+        return *this;
+    }
+
+
+    size_t Stats::GetAllocs() const
+    {
+        size_t ret = 0;
+        for (int i = 0; i < PhaseCount; ++i)
+            ret += allocs[i];
+        return ret;
+    }
+
+
+    size_t Stats::GetAllocBytes() const
+    {
+        size_t ret = 0;
+        for (int i = 0; i < PhaseCount; ++i)
+            ret += allocBytes[i];
+        return ret;
+    }
+
+
+    size_t Stats::GetPeakBytes() const
+    {
+        return *std::max_element(peakBytes, peakBytes + PhaseCount);
+    }
+
+
+    double Stats::GetIPC(Phase phase) const
+    {
+        if (!perf[phase][PerfCycles])
+            return 0.0;
+        return double(perf[phase][PerfInstructions]) / perf[phase][PerfCycles];
+    }
+
+
+    std::string Stats::ToJson() const
+    {
+        std::string ret = "{\"phases\":{";
+        char buf[192];
+
+        for (int i = 0; i < PhaseCount; ++i)
+        {
+            std::snprintf(buf, sizeof buf, "%s\"%s\":{\"ms\":%.4f,\"calls\":%lu,\"allocs\":%lu,\"bytes\":%lu,\"peak\":%lu",
+                    i ? "," : "", GetName(Phase(i)), times[i] * 1e3, (unsigned long)calls[i],
+                    (unsigned long)allocs[i], (unsigned long)allocBytes[i], (unsigned long)peakBytes[i]);
+            ret += buf;
+#ifdef CKNOT_PERF
+            for (int j = 0; j < PerfEventCount; ++j)
+            {
+                std::snprintf(buf, sizeof buf, ",\"%s\":%llu", GetName(PerfEvent(j)), perf[i][j]);
+                ret += buf;
+            }
+#endif
+            ret += "}";
+        }
+
+        ret += "},\"counts\":{";
+
+        for (int i = 0; i < CountCount; ++i)
+        {
+            std::snprintf(buf, sizeof buf, "%s\"%s\":%lu", i ? "," : "", GetName(Counter(i)), (unsigned long)counts[i]);
+            ret += buf;
+        }
+
+        std::snprintf(buf, sizeof buf, "},\"allocs\":%lu,\"bytes\":%lu,\"peak\":%lu}",
+                (unsigned long)GetAllocs(), (unsigned long)GetAllocBytes(), (unsigned long)GetPeakBytes());
+        ret += buf;
+
+        return ret;
+    }
+
+
+    const char* Stats::GetName(Phase phase)
+    {
+        static const char* const names[PhaseCount] = {"strokes", "remove", "graph", "trace", "splines", "mesh"};
+        return names[phase];
+    }
+
+
+    const char* Stats::GetName(Counter counter)
+    {
+        static const char* const names[CountCount] = {"strokes", "junctions", "nodes", "threads", "knots", "vertices",
+            "templates", "instances"};
+        return names[counter];
+    }
+
+
+    const char* Stats::GetName(PerfEvent event)
+    {
+        static const char* const names[PerfEventCount] = {"cycles", "instructions", "cacheMisses", "branchMisses"};
+        return names[event];
+    }
+
+
+    WorkerStats::WorkerStats()
+        :items(0), starved(0.0), blocked(0.0), starves(0), blocks(0)
+    {
+        for (int i = 0; i < MaxSteps; ++i)
+            steps[i] = 0.0;
+    }
+
+
+    WorkerStats& WorkerStats::operator+=(const WorkerStats& rhs)
+    {
+        items += rhs.items;
+        for (int i = 0; i < MaxSteps; ++i)
+            steps[i] += rhs.steps[i];
+        starved += rhs.starved;
+        blocked += rhs.blocked;
+        starves += rhs.starves;
+        blocks += rhs.blocks;
+        return *this;
+    }
+
+
+    double WorkerStats::GetBusy() const
+    {
+        double busy = 0.0;
+        for (int i = 0; i < MaxSteps; ++i)
+            busy += steps[i];
+        return busy;
+    }
+
+
+    ScopedPhase::ScopedPhase(Stats* stats, Phase phase)
+        :mStats(stats), mPhase(phase), mStart(0.0)
+    {
+        if (!mStats)
+            return;
+
+        mStart = Stats::Now();
+
+        //Restart the peak so it only sees this phase. The destructor puts the old one back.
+        AllocCounters& c = GetAllocCounters();
+        mAllocs = c;
+        c.peak = c.live;
+
+#ifdef CKNOT_PERF
+        //Last, so the counts leave out as much of our own bookkeeping as they can.
+        mPerf = ReadPerfCounters();
+#endif
+    }
+
+
+    ScopedPhase::~ScopedPhase()
+    {
+        if (!mStats)
+            return;
+
+#ifdef CKNOT_PERF
+        const PerfCounters perf = ReadPerfCounters();
+        for (int i = 0; i < PerfEventCount; ++i)
+            mStats->perf[mPhase][i] += perf.values[i] - mPerf.values[i];
+#endif
+
+        mStats->times[mPhase] += Stats::Now() - mStart;
+        ++mStats->calls[mPhase];
+
+        AllocCounters& c = GetAllocCounters();
+        mStats->allocs[mPhase] += c.count - mAllocs.count;
+        mStats->allocBytes[mPhase] += c.bytes - mAllocs.bytes;
+        if (c.peak > mAllocs.live)
+            mStats->peakBytes[mPhase] = std::max(mStats->peakBytes[mPhase], size_t(c.peak - mAllocs.live));
+
+        c.peak = std::max(c.peak, mAllocs.peak);
+    }
+
+
+    double Stats::Now()
+    {
+        using namespace std::chrono;
+        return duration<double>(steady_clock::now().time_since_epoch()).count();
+    }
+
+}
@@ -0,0 +1,127 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STATS_HPP__
+#define __STATS_HPP__
+
+#include <cstddef>
+#include <string>
+#include "alloc.hpp"
+#include "perfcount.hpp"
+#include "trace.hpp"
+
+///Timing and counters for the knot pipeline.
+/**Build with CKNOT_STATS defined to collect them. Without it the CKNOT_PHASE and CKNOT_COUNT
+ * macros compile to nothing, and every Stats stays zero. Also define CKNOT_ALLOC_STATS to count
+ * the heap allocations made in each phase, and CKNOT_PERF to read the CPU's own counters around
+ * them. With CKNOT_TRACE, phases also show up in the trace.
+ */
+namespace CKnot
+{
+
+    enum Phase {PhaseStrokes, PhaseRemove, PhaseGraph, PhaseTrace, PhaseSplines, PhaseMesh, PhaseCount};
+
+    enum Counter {CountStrokes, CountJunctions, CountNodes, CountThreads, CountKnots, CountVertices,
+        CountTemplates, CountInstances, CountCount};
+
+    ///Where the time went while making one knot.
+    struct Stats
+    {
+        double times[PhaseCount]; ///<Seconds spent in each phase.
+        size_t calls[PhaseCount]; ///<Times each phase was entered.
+        size_t allocs[PhaseCount]; ///<Heap allocations made in each phase.
+        size_t allocBytes[PhaseCount]; ///<Bytes asked for in each phase.
+        size_t peakBytes[PhaseCount]; ///<Most heap each phase had live on top of what was live when it started.
+        unsigned long long perf[PhaseCount][PerfEventCount]; ///<Hardware counts in each phase.
+        size_t counts[CountCount];
+
+        Stats() {Clear();}
+
+        void Clear();
+        Stats& operator+=(const Stats& rhs); ///<Adds up everything but the peaks, which take the larger.
+
+        size_t GetAllocs() const; ///<Returns the allocations made in all phases.
+        size_t GetAllocBytes() const;
+        size_t GetPeakBytes() const; ///<Returns the largest peak of any phase.
+        double GetIPC(Phase phase) const; ///<Returns instructions per cycle in a phase, or 0 if not counted.
+
+        std::string ToJson() const; ///<Returns the stats as a single line JSON object.
+
+        static const char* GetName(Phase phase);
+        static const char* GetName(Counter counter);
+        static const char* GetName(PerfEvent event);
+        static double Now(); ///<Returns a monotonic time in seconds.
+    };
+
+
+    ///Where one worker thread of a batch tool spent its time.
+    /**Time on items is split into up to MaxSteps steps, which each tool numbers for itself. Starved and
+     * blocked are for workers that pass items along queues.
+     */
+    struct WorkerStats
+    {
+        enum {MaxSteps = 4};
+
+        size_t items; ///<Items finished.
+        double steps[MaxSteps]; ///<Seconds spent on each step of the items.
+        double starved; ///<Seconds waiting for an empty input queue.
+        double blocked; ///<Seconds waiting for a full output queue.
+        size_t starves, blocks; ///<How many waits of each kind.
+
+        WorkerStats();
+        WorkerStats& operator+=(const WorkerStats& rhs);
+
+        double GetBusy() const; ///<Returns the seconds spent on all steps.
+    };
+
+
+    ///Adds the time and allocations until it goes out of scope to a phase. Does nothing if stats is null.
+    class ScopedPhase
+    {
+        public:
+            ScopedPhase(Stats* stats, Phase phase);
+            ~ScopedPhase();
+
+        private:
+            ScopedPhase(const ScopedPhase&);
+            ScopedPhase& operator=(const ScopedPhase&);
+
+            Stats* mStats;
+            Phase mPhase;
+            double mStart;
+            AllocCounters mAllocs; ///<This thread's counters when the phase started.
+#ifdef CKNOT_PERF
+            PerfCounters mPerf;
+#endif
+    };
+
+}
+
+#define CKNOT_CONCAT2(a, b) a##b
+#define CKNOT_CONCAT(a, b) CKNOT_CONCAT2(a, b)
+
+#ifdef CKNOT_STATS
+#define CKNOT_PHASE_STATS(stats, phase) CKnot::ScopedPhase CKNOT_CONCAT(ckPhase, __LINE__)(stats, phase)
+#define CKNOT_COUNT(stats, counter, n) do {if (stats) (stats)->counts[counter] += (n);} while (0)
+#else
+#define CKNOT_PHASE_STATS(stats, phase) ((void)0)
+#define CKNOT_COUNT(stats, counter, n) ((void)0)
+#endif
+
+#define CKNOT_PHASE(stats, phase) CKNOT_PHASE_STATS(stats, phase); CKNOT_TRACE_SCOPE(CKnot::Stats::GetName(phase))
+
+#endif /*__STATS_HPP__*/
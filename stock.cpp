@@ -0,0 +1,235 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stock.hpp"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include "export.hpp"
+
+namespace CKnot
+{
+
+    namespace
+    {
+        const char* const NextName = "/next"; ///<Holds the base seed the next run starts with, and its knot's key.
+        const char* const LockName = "/lock";
+    }
+
+
+    KnotStock::KnotStock(const char* dir)
+        :mDir(dir), mLockFd(Lock(mDir)), mCache(16 * 1024 * 1024, mLockFd >= 0 ? dir : 0), mQuit(false), mCounters(),
+        mReadied(0), mThread(&KnotStock::Run, this)
+    {
+    }
+
+
+    KnotStock::~KnotStock()
+    {
+        {
+            std::lock_guard<std::mutex> hold(mLock);
+            mQuit = true;
+        }
+        mWake.notify_one();
+        mThread.join();
+
+        //Knots made ahead but never taken. Another run would only find them by chance.
+        for (std::set<KnotCache::Key>::const_iterator it = mSaved.begin(); it != mSaved.end(); ++it)
+            if (*it != mReadied)
+                mCache.Remove(*it);
+
+        if (mLockFd >= 0)
+            close(mLockFd);
+    }
+
+
+    unsigned int KnotStock::Start(unsigned int fallback, double aspect, const LatticeParams& lattice)
+    {
+        //Without the folder there's no knot from the last run, and none worth readying for the next.
+        if (mLockFd < 0)
+            return fallback;
+
+        unsigned int seed = fallback;
+        unsigned long long readied = 0;
+        const std::string next = mDir + NextName;
+        if (FILE* f = std::fopen(next.c_str(), "r"))
+        {
+            unsigned int saved;
+            if (std::fscanf(f, "%u %llx", &saved, &readied) >= 1)
+                seed = saved;
+            std::fclose(f);
+        }
+        std::remove(next.c_str());
+
+        //The last run handed its readied knot on, so it is this run's to delete, taken or not. It is no use if
+        //the aspect or lattice has changed since.
+        const KnotCache::Key key = GetKey(Engine::GetKnotSeed(seed, 0), aspect, lattice);
+        if (readied && readied != key)
+            mCache.Remove(readied);
+        else if (mCache.Get(key))
+        {
+            std::lock_guard<std::mutex> hold(mLock);
+            mSaved.insert(key);
+        }
+
+        Job job;
+        job.base = Engine::GetKnotSeed(fallback, seed);
+        job.seed = Engine::GetKnotSeed(job.base, 0);
+        job.aspect = aspect;
+        job.lattice = lattice;
+        job.next = true;
+        {
+            std::lock_guard<std::mutex> hold(mLock);
+            mJobs.push_back(job);
+        }
+        mWake.notify_one();
+
+        return seed;
+    }
+
+
+    AutoArt KnotStock::Take(unsigned int seed, double aspect, const LatticeParams& lattice, Random& random)
+    {
+        const KnotCache::Key key = GetKey(seed, aspect, lattice);
+        const KnotCache::BlobPtr blob = mCache.Get(key);
+
+        AutoArt art;
+        if (blob)
+        {
+            art = DecodeKnot(blob->GetData(), blob->GetSize(), random);
+            mCache.Remove(key);
+        }
+
+        std::lock_guard<std::mutex> hold(mLock);
+        if (art.get())
+            mSaved.erase(key);
+        ++(art.get() ? mCounters.taken : mCounters.missed);
+        return art;
+    }
+
+
+    void KnotStock::Prefetch(unsigned int seed, double aspect, const LatticeParams& lattice)
+    {
+        Job job;
+        job.seed = seed;
+        job.aspect = aspect;
+        job.lattice = lattice;
+        job.next = false;
+        job.base = 0;
+
+        {
+            //The engine only wants its next knot, so any it asked for before are dropped.
+            std::lock_guard<std::mutex> hold(mLock);
+            for (std::deque<Job>::iterator it = mJobs.begin(); it != mJobs.end();)
+                it = it->next ? it + 1 : mJobs.erase(it);
+            mJobs.push_back(job);
+        }
+        mWake.notify_one();
+    }
+
+
+    KnotStock::Counters KnotStock::GetCounters() const
+    {
+        std::lock_guard<std::mutex> hold(mLock);
+        return mCounters;
+    }
+
+
+    KnotCache::Key KnotStock::GetKey(unsigned int seed, double aspect, const LatticeParams& lattice)
+    {
+        return Hash().Add("stock").Add(seed).Add(aspect).Add(lattice.junctionsPer).Add(lattice.bounce)
+            .Add(lattice.glance).Add(lattice.removal).Get();
+    }
+
+
+    int KnotStock::Lock(const std::string& dir)
+    {
+        //The lock file is left behind, as deleting it would let a third stock lock a new one beside the first.
+        const int fd = open((dir + LockName).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+
+    void KnotStock::Make(const Job& job)
+    {
+        //As Engine::NewArt makes them.
+        Random random(job.seed);
+        StrokeList strokes = CreateSquareStrokes(random, job.aspect, 1.0, job.lattice);
+        strokes = RemoveStrokes(random, strokes, job.lattice);
+        AutoArt art = CreateThread(strokes);
+
+        std::string data;
+        EncodeKnot(*art, random, data);
+        const KnotCache::Key key = GetKey(job.seed, job.aspect, job.lattice);
+        mCache.Put(key, data);
+        if (mLockFd >= 0)
+        {
+            std::lock_guard<std::mutex> hold(mLock);
+            mSaved.insert(key);
+        }
+
+        if (!job.next || mLockFd < 0)
+            return;
+
+        //Written under another name then renamed, like the knots, so Start never reads half a seed.
+        const std::string next = mDir + NextName;
+        const std::string temp = next + ".tmp";
+        FILE* f = std::fopen(temp.c_str(), "w");
+        if (!f)
+            return;
+
+        const bool ok = std::fprintf(f, "%u %016llx\n", job.base, (unsigned long long)key) > 0;
+        if (std::fclose(f) != 0 || !ok || std::rename(temp.c_str(), next.c_str()) != 0)
+        {
+            std::remove(temp.c_str());
+            return;
+        }
+
+        std::lock_guard<std::mutex> hold(mLock);
+        mReadied = key;
+    }
+
+
+    void KnotStock::Run()
+    {
+        std::unique_lock<std::mutex> hold(mLock);
+        for (;;)
+        {
+            while (!mQuit && mJobs.empty())
+                mWake.wait(hold);
+            if (mQuit)
+                return;
+
+            const Job job = mJobs.front();
+            mJobs.pop_front();
+
+            hold.unlock();
+            Make(job);
+            hold.lock();
+
+            ++mCounters.made;
+        }
+    }
+
+}
@@ -0,0 +1,106 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STOCK_HPP__
+#define __STOCK_HPP__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include "anim.hpp"
+#include "cache.hpp"
+
+namespace CKnot
+{
+
+    ///Knots made ahead of time on a thread of their own, and kept in a folder across runs.
+    /**Start picks the run's seed. It is the one the last run readied, whose first knot is already in the folder
+     * and mapped straight from there, so the first frame needn't wait for a knot to be made. A fresh seed is
+     * then picked for the next run and its first knot made in the background. Only once that is saved is the
+     * seed written down, so a run cut short leaves nothing half made, just a slow start next time.
+     * As a KnotSource, the stock makes each knot the engine is about to want while the current one is up.
+     * Knots are saved as EncodeKnot writes them, which holds their splines and the random state after them, so
+     * each is taken exactly as the engine would have made it. Taken knots are deleted, and on the way out the
+     * stock deletes the rest of the knots it made, bar the one readied for the next run, so the folder never
+     * holds more than a few. It only deletes files it made or was handed by the last run's seed.
+     * A stock locks its folder while it runs. One that finds the folder locked by another still makes knots
+     * ahead, but keeps them in memory and leaves the folder alone.
+     */
+    class KnotStock : public KnotSource
+    {
+        public:
+            struct Counters
+            {
+                size_t taken; ///<Knots handed out ready.
+                size_t missed; ///<Knots asked for but not ready.
+                size_t made; ///<Knots made in the background.
+            };
+
+            explicit KnotStock(const char* dir); ///<Keeps knots in dir, which must exist, unless another stock has it.
+            ~KnotStock(); ///<Finishes the knot being made, dropping any others asked for.
+
+            ///Returns the seed to run with, fallback if the last run didn't ready one, and readies the next run.
+            /**Call once, before the engine's first knot. The aspect and lattice are the run's.
+             */
+            unsigned int Start(unsigned int fallback, double aspect, const LatticeParams& lattice);
+
+            virtual AutoArt Take(unsigned int seed, double aspect, const LatticeParams& lattice, Random& random);
+            virtual void Prefetch(unsigned int seed, double aspect, const LatticeParams& lattice);
+
+            Counters GetCounters() const;
+            bool IsLocked() const {return mLockFd >= 0;} ///<Whether this stock has its folder.
+
+        private:
+            KnotStock(const KnotStock&);
+            KnotStock& operator=(const KnotStock&);
+
+            ///A knot to make.
+            struct Job
+            {
+                unsigned int seed;
+                double aspect;
+                LatticeParams lattice;
+                bool next; ///<Whether it starts the next run, so its base seed is saved once it is made.
+                unsigned int base;
+            };
+
+            static KnotCache::Key GetKey(unsigned int seed, double aspect, const LatticeParams& lattice);
+            static int Lock(const std::string& dir); ///<Returns the locked lock file's descriptor, or -1.
+            void Make(const Job& job);
+            void Run();
+
+            std::string mDir;
+            int mLockFd; ///<Held for the stock's life, or -1 if another stock has the folder.
+            KnotCache mCache; ///<Memory only without the lock.
+
+            mutable std::mutex mLock; ///<Guards the fields below.
+            std::condition_variable mWake;
+            std::deque<Job> mJobs;
+            bool mQuit;
+            Counters mCounters;
+            std::set<KnotCache::Key> mSaved; ///<Knots in the folder that are this stock's to delete.
+            KnotCache::Key mReadied; ///<The next run's first knot, left in the folder on the way out, or 0.
+
+            std::thread mThread; ///<Last, so it starts once the rest is ready.
+    };
+
+}
+
+#endif /*__STOCK_HPP__*/
@@ -0,0 +1,179 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace CKnot
+{
+    namespace Trace
+    {
+
+        namespace
+        {
+            struct Event
+            {
+                const char* name;
+                double begin, end;
+            };
+
+            ///Events from one thread. Only that thread writes, Write reads up to count.
+            struct Buffer
+            {
+                static const size_t Capacity = 1 << 15;
+
+                int tid;
+                std::string name;
+                Event events[Capacity];
+                std::atomic<size_t> count;
+                size_t dropped; ///<Events lost because the buffer was full.
+
+                explicit Buffer(int tid):tid(tid), count(0), dropped(0){}
+            };
+
+            std::atomic<bool> Enabled(false);
+            std::atomic<bool> Started(false);
+            double Origin = 0.0; ///<Time of the first Enable, events are relative to it.
+
+            std::mutex RegistryMutex; ///<Only held to add a thread, never per event.
+            std::vector<Buffer*> Registry; ///<Buffers are kept after their threads exit.
+
+            thread_local Buffer* Local = 0;
+
+            Buffer* GetBuffer()
+            {
+                if (!Local)
+                {
+                    std::lock_guard<std::mutex> lock(RegistryMutex);
+                    Local = new Buffer(int(Registry.size()) + 1);
+                    Registry.push_back(Local);
+                }
+                return Local;
+            }
+
+            void WriteString(FILE* f, const char* s)
+            {
+                std::fputc('"', f);
+                for (; *s; ++s)
+                {
+                    if (*s == '"' || *s == '\\')
+                        std::fputc('\\', f);
+                    if ((unsigned char)*s >= 0x20)
+                        std::fputc(*s, f);
+                }
+                std::fputc('"', f);
+            }
+        }
+
+
+        void Enable(bool on)
+        {
+            if (on && !Started.exchange(true))
+                Origin = Now();
+            Enabled.store(on, std::memory_order_release);
+        }
+
+
+        bool IsEnabled()
+        {
+            return Enabled.load(std::memory_order_relaxed);
+        }
+
+
+        void SetThreadName(const char* name)
+        {
+            GetBuffer()->name = name;
+        }
+
+
+        void Record(const char* name, double begin, double end)
+        {
+            Buffer* b = GetBuffer();
+            const size_t n = b->count.load(std::memory_order_relaxed);
+
+            if (n == Buffer::Capacity)
+            {
+                ++b->dropped;
+                return;
+            }
+
+            b->events[n].name = name;
+            b->events[n].begin = begin;
+            b->events[n].end = end;
+            b->count.store(n + 1, std::memory_order_release);
+        }
+
+
+        bool Write(const char* path)
+        {
+            FILE* f = std::fopen(path, "w");
+            if (!f)
+                return false;
+
+            std::lock_guard<std::mutex> lock(RegistryMutex);
+
+            std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+            bool first = true;
+            size_t dropped = 0;
+
+            for (size_t i = 0; i < Registry.size(); ++i)
+            {
+                const Buffer& b = *Registry[i];
+
+                if (!b.name.empty())
+                {
+                    std::fprintf(f, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":",
+                            first ? "" : ",\n", b.tid);
+                    WriteString(f, b.name.c_str());
+                    std::fprintf(f, "}}");
+                    first = false;
+                }
+
+                const size_t count = b.count.load(std::memory_order_acquire);
+                for (size_t e = 0; e < count; ++e)
+                {
+                    const Event& ev = b.events[e];
+                    std::fprintf(f, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+                            first ? "" : ",\n", b.tid, (ev.begin - Origin) * 1e6, (ev.end - ev.begin) * 1e6);
+                    WriteString(f, ev.name);
+                    std::fputc('}', f);
+                    first = false;
+                }
+
+                dropped += b.dropped;
+            }
+
+            std::fprintf(f, "\n],\"otherData\":{\"dropped\":%lu}}\n", (unsigned long)dropped);
+
+            return std::fclose(f) == 0;
+        }
+
+
+        double Now()
+        {
+            using namespace std::chrono;
+            return duration<double>(steady_clock::now().time_since_epoch()).count();
+        }
+
+    }
+}
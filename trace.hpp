@@ -0,0 +1,74 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TRACE_HPP__
+#define __TRACE_HPP__
+
+///Timeline tracing in the Chrome trace event format, which Perfetto and chrome://tracing load.
+/**Build with CKNOT_TRACE defined and call Trace::Enable to record. Each thread records into its own
+ * buffer without locking, and Trace::Write saves every thread's events. Without CKNOT_TRACE the
+ * CKNOT_TRACE_SCOPE macro compiles to nothing.
+ */
+namespace CKnot
+{
+    namespace Trace
+    {
+        void Enable(bool on); ///<Starts or stops recording. Enabling also sets the time origin the first time.
+        bool IsEnabled();
+
+        void SetThreadName(const char* name); ///<Names the calling thread in the timeline.
+
+        ///Records a span on the calling thread. name must outlive the trace, a string literal is best.
+        void Record(const char* name, double begin, double end);
+
+        bool Write(const char* path); ///<Saves everything recorded so far as Chrome trace JSON. Stop recording first.
+
+        double Now(); ///<Returns a monotonic time in seconds.
+
+        ///Records the span from construction to destruction.
+        class Scope
+        {
+            public:
+                explicit Scope(const char* name)
+                    :mName(IsEnabled() ? name : 0), mStart(mName ? Now() : 0.0){}
+
+                ~Scope()
+                {
+                    if (mName)
+                        Record(mName, mStart, Now());
+                }
+
+            private:
+                Scope(const Scope&);
+                Scope& operator=(const Scope&);
+
+                const char* mName;
+                double mStart;
+        };
+    }
+}
+
+#define CKNOT_TRACE_CONCAT2(a, b) a##b
+#define CKNOT_TRACE_CONCAT(a, b) CKNOT_TRACE_CONCAT2(a, b)
+
+#ifdef CKNOT_TRACE
+#define CKNOT_TRACE_SCOPE(name) CKnot::Trace::Scope CKNOT_TRACE_CONCAT(ckTrace, __LINE__)(name)
+#else
+#define CKNOT_TRACE_SCOPE(name) ((void)0)
+#endif
+
+#endif /*__TRACE_HPP__*/
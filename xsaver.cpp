@@ -0,0 +1,411 @@
+/* celtic_knots - generate and animate random Celtic knots
+ * Copyright (C) 2008 Lewis Van Winkle
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//X11 front-end. Runs in its own window, or as an xscreensaver hack drawing into
+//the window given by XSCREENSAVER_WINDOW, -window-id or -root, which means
+//XSCREENSAVER_WINDOW when it is set.
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/keysym.h>
+#include <GL/gl.h>
+#include <GL/glx.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+#include "anim.hpp"
+#include "glrender.hpp"
+#include "stock.hpp"
+
+static volatile sig_atomic_t Quit = 0;
+
+static void OnSignal(int)
+{
+    Quit = 1;
+}
+
+
+static double Now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+}
+
+
+static void Usage(const char* argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-root | -window-id ID] [-geometry WxH] [-threads T] [-overlay] [-stats-fd FD] [-stock DIR | -no-stock] [-trace FILE]\n"
+            "  -root          draw on the root window, or xscreensaver's if it started us\n"
+            "  -window-id ID  draw into an existing window (also taken from XSCREENSAVER_WINDOW)\n"
+            "  -geometry WxH  size of the window when running standalone\n"
+            "  -threads T     mesh new knots on T threads (default one per core)\n"
+            "  -overlay       show frame statistics over the animation (o toggles it)\n"
+            "  -stats-fd FD   write frame statistics to FD as a JSON line each second\n"
+            "  -stock DIR     keep knots made ahead in DIR, so the next run starts on one\n"
+            "                 (default a folder per display and screen in $XDG_CACHE_HOME/celtic_knots\n"
+            "                 or ~/.cache/celtic_knots)\n"
+            "  -no-stock      make every knot when it is due\n"
+            "  -trace FILE    save a Chrome trace of the run on exit (needs CKNOT_TRACE)\n"
+            "In a window, the arrow keys pan, + and - zoom and 0 shows the whole knot again.\n"
+            "f runs bands of light along the threads.\n",
+            argv0);
+}
+
+
+///Writes a line of stats without ever blocking the animation. Returns false if the fd is no good.
+static bool WriteStats(int fd, const std::string& json)
+{
+    const std::string line = json + "\n";
+    const ssize_t n = write(fd, line.data(), line.size());
+
+    //If nobody is keeping up with the stream, drop lines rather than stall.
+    return n >= 0 || errno == EAGAIN || errno == EINTR;
+}
+
+
+///Returns the folder knots are stocked in by default, made if it isn't there, or empty if there's nowhere.
+/**Each display and screen has its own, as xscreensaver runs a copy of us on each at once.
+ */
+static std::string GetStockDir(Display* dpy)
+{
+    std::string dir;
+    if (const char* cache = getenv("XDG_CACHE_HOME"))
+        dir = cache;
+    else if (const char* home = getenv("HOME"))
+    {
+        dir = std::string(home) + "/.cache";
+        mkdir(dir.c_str(), 0755);
+    }
+    else
+        return dir;
+
+    dir += "/celtic_knots";
+    mkdir(dir.c_str(), 0755);
+
+    //The display's name without its screen, made safe for a file name, then the screen, e.g. "_0.0".
+    std::string name = DisplayString(dpy);
+    const size_t colon = name.rfind(':');
+    const size_t dot = name.find('.', colon == std::string::npos ? 0 : colon);
+    if (dot != std::string::npos)
+        name.erase(dot);
+    for (size_t i = 0; i < name.size(); ++i)
+        if (name[i] == '/' || name[i] == ':')
+            name[i] = '_';
+
+    char screen[16];
+    snprintf(screen, sizeof screen, ".%d", DefaultScreen(dpy));
+    dir += "/" + name + screen;
+    mkdir(dir.c_str(), 0755);
+    return dir;
+}
+
+
+///Finds the visual of an existing window so a GL context can be made for it.
+static XVisualInfo* GetWindowVisual(Display* dpy, Window win)
+{
+    XWindowAttributes xwa;
+    XGetWindowAttributes(dpy, win, &xwa);
+
+    XVisualInfo vt;
+    vt.visualid = XVisualIDFromVisual(xwa.visual);
+    int n = 0;
+    return XGetVisualInfo(dpy, VisualIDMask, &vt, &n);
+}
+
+
+int main(int argc, char* argv[])
+{
+    const double startTime = Now();
+    Window target = 0;
+    bool root = false;
+    int w = 800, h = 600;
+    const char* trace = 0;
+    bool overlay = false;
+    int statsFd = -1;
+    int threads = 0;
+    std::string stockDir;
+    bool stocked = true;
+
+    //xscreensaver's own window, its virtual root, if it started us.
+    Window virtualRoot = 0;
+    if (const char* env = getenv("XSCREENSAVER_WINDOW"))
+        virtualRoot = Window(strtoul(env, 0, 0));
+    target = virtualRoot;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-root"))
+            root = true;
+        else if (!strcmp(argv[i], "-window-id") && i + 1 < argc)
+            target = Window(strtoul(argv[++i], 0, 0));
+        else if (!strcmp(argv[i], "-geometry") && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)
+            {
+                Usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-window"))
+            target = 0;
+        else if (!strcmp(argv[i], "-trace") && i + 1 < argc)
+            trace = argv[++i];
+        else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-overlay"))
+            overlay = true;
+        else if (!strcmp(argv[i], "-stats-fd") && i + 1 < argc)
+            statsFd = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-stock") && i + 1 < argc)
+            stockDir = argv[++i];
+        else if (!strcmp(argv[i], "-no-stock"))
+            stocked = false;
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Display* dpy = XOpenDisplay(0);
+    if (!dpy)
+    {
+        fprintf(stderr, "%s: cannot open display\n", argv[0]);
+        return 1;
+    }
+
+    //Like other hacks, -root means xscreensaver's window when there is one, as the real root is hidden behind it.
+    if (root)
+        target = virtualRoot ? virtualRoot : RootWindow(dpy, DefaultScreen(dpy));
+
+    Window win;
+    XVisualInfo* vi;
+    Atom wmDelete = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
+
+    if (target)
+    {
+        //Someone else owns the window, so use whatever visual it already has.
+        win = target;
+        vi = GetWindowVisual(dpy, win);
+
+        XWindowAttributes xwa;
+        XGetWindowAttributes(dpy, win, &xwa);
+        w = xwa.width;
+        h = xwa.height;
+
+        XSelectInput(dpy, win, StructureNotifyMask | ExposureMask);
+    }
+    else
+    {
+        int attribs[] = {GLX_RGBA, GLX_DOUBLEBUFFER, GLX_DEPTH_SIZE, 16,
+            GLX_RED_SIZE, 8, GLX_GREEN_SIZE, 8, GLX_BLUE_SIZE, 8, None};
+        vi = glXChooseVisual(dpy, DefaultScreen(dpy), attribs);
+        if (!vi)
+        {
+            fprintf(stderr, "%s: no double buffered RGB visual\n", argv[0]);
+            return 1;
+        }
+
+        XSetWindowAttributes swa;
+        swa.colormap = XCreateColormap(dpy, RootWindow(dpy, vi->screen), vi->visual, AllocNone);
+        swa.event_mask = StructureNotifyMask | ExposureMask | KeyPressMask;
+        swa.background_pixel = 0;
+        swa.border_pixel = 0;
+
+        win = XCreateWindow(dpy, RootWindow(dpy, vi->screen), 0, 0, w, h, 0, vi->depth,
+                InputOutput, vi->visual, CWColormap | CWEventMask | CWBackPixel | CWBorderPixel, &swa);
+
+        XStoreName(dpy, win, "Celtic Knots");
+        XSetWMProtocols(dpy, win, &wmDelete, 1);
+        XMapWindow(dpy, win);
+    }
+
+    if (!vi)
+    {
+        fprintf(stderr, "%s: cannot find the window's visual\n", argv[0]);
+        return 1;
+    }
+
+    GLXContext ctx = glXCreateContext(dpy, vi, 0, True);
+    XFree(vi);
+    if (!ctx)
+    {
+        fprintf(stderr, "%s: cannot create a GL context\n", argv[0]);
+        return 1;
+    }
+    glXMakeCurrent(dpy, win, ctx);
+
+    signal(SIGTERM, OnSignal);
+    signal(SIGINT, OnSignal);
+
+    if (statsFd >= 0)
+    {
+        signal(SIGPIPE, SIG_IGN);
+        fcntl(statsFd, F_SETFL, fcntl(statsFd, F_GETFL) | O_NONBLOCK);
+    }
+
+    if (stocked && stockDir.empty())
+        stockDir = GetStockDir(dpy);
+
+    //The stock picks the seed, so the first knot can be one it made last time.
+    unsigned int seed = (unsigned int)(time(0) ^ getpid());
+    std::unique_ptr<CKnot::KnotStock> stock;
+    if (stocked && !stockDir.empty())
+    {
+        stock.reset(new CKnot::KnotStock(stockDir.c_str()));
+        seed = stock->Start(seed, double(w) / double(h > 0 ? h : 1), CKnot::LatticeParams());
+    }
+
+    CKnot::Pool pool(threads > 0 ? threads : 0);
+    CKnot::Engine engine(w, h, seed);
+    if (pool.GetThreadCount() > 1)
+        engine.SetPool(&pool);
+    engine.SetSource(stock.get());
+    CKnot::GLRenderer renderer;
+    CKnot::Monitor monitor;
+    double lastTime = Now();
+    bool firstFrame = true;
+
+    if (trace)
+    {
+        CKnot::Trace::SetThreadName("main");
+        CKnot::Trace::Enable(true);
+    }
+
+    while (!Quit)
+    {
+        CKNOT_TRACE_SCOPE("frame");
+
+        while (XPending(dpy))
+        {
+            XEvent ev;
+            XNextEvent(dpy, &ev);
+
+            switch (ev.type)
+            {
+                case ConfigureNotify:
+                    if (ev.xconfigure.width != w || ev.xconfigure.height != h)
+                    {
+                        w = ev.xconfigure.width;
+                        h = ev.xconfigure.height;
+                        engine.Resize(w, h);
+                    }
+                    break;
+
+                case KeyPress:
+                {
+                    const KeySym key = XLookupKeysym(&ev.xkey, 0);
+                    if (key == XK_Escape || key == XK_q)
+                        Quit = 1;
+                    else if (key == XK_o)
+                        overlay = !overlay;
+                    else if (key == XK_f)
+                    {
+                        CKnot::Flow flow = engine.GetFlow();
+                        flow.depth = flow.depth > 0.0f ? 0.0f : 0.6f;
+                        engine.SetFlow(flow, 0.15);
+                    }
+                    else
+                    {
+                        //Pans move a tenth of what is in view.
+                        CKnot::Camera camera = engine.GetCamera();
+                        const double step = 0.1 / camera.zoom;
+                        if (key == XK_Left)
+                            camera.panX -= step;
+                        else if (key == XK_Right)
+                            camera.panX += step;
+                        else if (key == XK_Up)
+                            camera.panY -= step;
+                        else if (key == XK_Down)
+                            camera.panY += step;
+                        else if (key == XK_plus || key == XK_equal || key == XK_KP_Add)
+                            camera.zoom *= 1.25;
+                        else if (key == XK_minus || key == XK_KP_Subtract)
+                            camera.zoom /= 1.25;
+                        else if (key == XK_0)
+                            camera = CKnot::Camera();
+                        engine.SetCamera(camera);
+                    }
+                    break;
+                }
+
+                case ClientMessage:
+                    if (Atom(ev.xclient.data.l[0]) == wmDelete)
+                        Quit = 1;
+                    break;
+            }
+        }
+
+        const double now = Now();
+        engine.Update(now - lastTime);
+
+        CKnot::FrameSample sample;
+        sample.render = engine.Render(renderer, overlay ? &monitor : 0);
+        sample.interval = now - lastTime;
+        sample.work = Now() - now;
+        sample.knot = engine.GetKnot();
+        sample.genTime = engine.GetGenTime();
+        lastTime = now;
+
+        if (monitor.Add(sample) && statsFd >= 0 && !WriteStats(statsFd, monitor.ToJson()))
+        {
+            fprintf(stderr, "%s: stats stream closed\n", argv[0]);
+            statsFd = -1;
+        }
+
+        {
+            CKNOT_TRACE_SCOPE("swap");
+            glXSwapBuffers(dpy, win);
+        }
+
+        if (firstFrame)
+        {
+            monitor.SetStartup(Now() - startTime);
+            firstFrame = false;
+        }
+
+        usleep(10000); //Same pace as the Windows timer.
+    }
+
+    if (trace)
+    {
+        CKnot::Trace::Enable(false);
+        if (!CKnot::Trace::Write(trace))
+            fprintf(stderr, "%s: cannot write %s\n", argv[0], trace);
+    }
+
+    glXMakeCurrent(dpy, None, 0);
+    glXDestroyContext(dpy, ctx);
+    if (!target)
+        XDestroyWindow(dpy, win);
+    XCloseDisplay(dpy);
+
+    return 0;
+}